@@ -0,0 +1,237 @@
+/**
+ * parser_bench.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Times the parser of request heads on the requests of 'corpora'. The
+ * parsing which 'BaseHTTPRequestHandler::parse_request' did before is
+ * compared as well: the request line is trimmed and split into strings,
+ * and the header lines are read one by one into a map.
+ *
+ * The corpora are stored with LF line ends, which are replaced by CRLF.
+ * Another directory of corpora may be passed as the first argument.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <xalwart.server/request_parser.h>
+
+
+inline static const int RUNS_COUNT = 20;
+inline static const int PASSES_COUNT = 10000;
+
+struct Corpus
+{
+	std::string name;
+	std::string head;
+};
+
+static std::string read_head(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream content;
+	content << file.rdbuf();
+	std::string head;
+	for (auto c : content.str())
+	{
+		if (c == '\n')
+		{
+			head += '\r';
+		}
+
+		head += c;
+	}
+
+	while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0)
+	{
+		head += "\r\n";
+	}
+
+	return head;
+}
+
+static std::vector<Corpus> read_corpora(const std::filesystem::path& directory)
+{
+	std::vector<Corpus> corpora;
+	for (const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".txt")
+		{
+			corpora.push_back({entry.path().stem().string(), read_head(entry.path())});
+		}
+	}
+
+	std::sort(corpora.begin(), corpora.end(), [](const auto& left, const auto& right) {
+		return left.name < right.name;
+	});
+	return corpora;
+}
+
+static std::vector<std::string> split(const std::string& data, char separator)
+{
+	std::vector<std::string> result;
+	size_t begin = 0;
+	for (auto end = data.find(separator); end != std::string::npos; end = data.find(separator, begin))
+	{
+		result.push_back(data.substr(begin, end - begin));
+		begin = end + 1;
+	}
+
+	result.push_back(data.substr(begin));
+	return result;
+}
+
+static std::string trim(const std::string& data)
+{
+	auto begin = data.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos)
+	{
+		return "";
+	}
+
+	return data.substr(begin, data.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+// The parsing of the head by lines and splits of strings.
+static size_t parse_by_split(const std::string& head, std::map<std::string, std::string>& headers)
+{
+	auto line_end = head.find("\r\n");
+	auto request_line = head.substr(0, line_end);
+	while (!request_line.empty() && (request_line.back() == '\r' || request_line.back() == '\n'))
+	{
+		request_line.pop_back();
+	}
+
+	auto words = split(request_line, ' ');
+	if (words.size() != 3)
+	{
+		return 0;
+	}
+
+	auto version_parts = split(words[2], '/');
+	auto version_numbers = split(version_parts[1], '.');
+	auto major_version = std::stoul(version_numbers[0]);
+	auto minor_version = std::stoul(version_numbers[1]);
+	size_t position = line_end + 2;
+	while (true)
+	{
+		line_end = head.find("\r\n", position);
+		auto line = head.substr(position, line_end + 2 - position);
+		position = line_end + 2;
+		if (line == "\r\n")
+		{
+			break;
+		}
+
+		auto colon = line.find(':');
+		headers[line.substr(0, colon)] = trim(line.substr(colon + 1));
+	}
+
+	return major_version + minor_version + headers.size();
+}
+
+// Copies header fields to the map, as for handlers which use the map of
+// the request context.
+static void copy_headers(
+	std::string_view head, const xw::server::ParsedRequest& request, std::map<std::string, std::string>& headers
+)
+{
+	for (const auto& header : request.headers)
+	{
+		headers[std::string(header.name.in(head))] = std::string(header.value.in(head));
+	}
+}
+
+// Returns the best time of parsing a head in nanoseconds.
+template <typename FunctionT>
+static double time_parse(FunctionT parse)
+{
+	auto best_time = std::chrono::nanoseconds::max();
+	for (int run = 0; run < RUNS_COUNT; run++)
+	{
+		size_t result = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < PASSES_COUNT; pass++)
+		{
+			result += parse();
+		}
+
+		auto time = std::chrono::steady_clock::now() - start;
+		asm volatile("" : : "r"(result) : "memory");
+		best_time = std::min(best_time, std::chrono::duration_cast<std::chrono::nanoseconds>(time));
+	}
+
+	return (double)best_time.count() / PASSES_COUNT;
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path directory = argc > 1 ? argv[1] : CORPORA_DIR;
+	auto corpora = read_corpora(directory);
+	if (corpora.empty())
+	{
+		std::fprintf(stderr, "no corpora in %s\n", directory.string().c_str());
+		return 1;
+	}
+
+	std::printf("Best time of parsing a request head, ns\n\n");
+	std::printf("%-16s%8s%8s%14s%14s%14s%14s\n", "corpus", "bytes", "headers", "split", "parse+map", "parse", "incremental");
+	xw::server::RequestParser parser(
+		xw::server::RequestParser::DEFAULT_MAX_LINE_LENGTH, xw::server::RequestParser::DEFAULT_MAX_HEADERS_COUNT
+	);
+	xw::server::IncrementalRequestParser incremental_parser;
+	xw::server::ParsedRequest request;
+	std::map<std::string, std::string> headers;
+	for (const auto& corpus : corpora)
+	{
+		const auto& head = corpus.head;
+		request.clear();
+		if (parser.parse(head, request) != head.size())
+		{
+			std::fprintf(stderr, "%s is not parsed as a whole\n", corpus.name.c_str());
+			return 1;
+		}
+
+		auto headers_count = request.headers.size();
+		auto split_time = time_parse([&]() {
+			headers.clear();
+			return parse_by_split(head, headers);
+		});
+		auto map_time = time_parse([&]() {
+			request.clear();
+			auto size = parser.parse(head, request);
+			headers.clear();
+			copy_headers(head, request, headers);
+			return size + headers.size();
+		});
+		auto parse_time = time_parse([&]() {
+			request.clear();
+			return parser.parse(head, request) + request.headers.size();
+		});
+
+		// The head is received in three parts.
+		auto incremental_time = time_parse([&]() {
+			std::string_view data(head);
+			incremental_parser.reset();
+			incremental_parser.parse(data.substr(0, data.size() / 3));
+			incremental_parser.parse(data.substr(0, data.size() * 2 / 3));
+			incremental_parser.parse(data);
+			return incremental_parser.head_size();
+		});
+		std::printf(
+			"%-16s%8zu%8zu%14.1f%14.1f%14.1f%14.1f\n", corpus.name.c_str(), head.size(), headers_count,
+			split_time, map_time, parse_time, incremental_time
+		);
+	}
+
+	return 0;
+}
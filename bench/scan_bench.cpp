@@ -0,0 +1,178 @@
+/**
+ * scan_bench.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Times the scanners of received data against scalar versions on short
+ * and long lines. The line end is also compared with the search of
+ * "\r\n" which 'SocketIO::read_line' used before.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include <xalwart.server/simd.h>
+
+
+inline static const size_t DATA_SIZE = 64 * 1024;
+inline static const int RUNS_COUNT = 200;
+
+static bool is_token_char(unsigned char c)
+{
+	if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+	{
+		return true;
+	}
+
+	return std::string_view("!#$%&'*+-.^_`|~").find((char)c) != std::string_view::npos;
+}
+
+static const char* find_byte_scalar(const char* begin, const char* end, char byte)
+{
+	while (begin != end && *begin != byte)
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+static const char* find_line_end_scalar(const char* begin, const char* end)
+{
+	auto* result = find_byte_scalar(begin, end, '\n');
+	return result == end ? nullptr : result + 1;
+}
+
+static const char* find_line_end_crlf(const char* begin, const char* end)
+{
+	auto position = std::string_view(begin, end - begin).find("\r\n");
+	return position == std::string_view::npos ? nullptr : begin + position + 2;
+}
+
+static const char* find_non_token_scalar(const char* begin, const char* end)
+{
+	while (begin != end && is_token_char((unsigned char)*begin))
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+static const char* find_control_scalar(const char* begin, const char* end)
+{
+	while (begin != end && (unsigned char)*begin > 0x20 && *begin != 0x7F)
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+// Lines of 'line_size' bytes with 'line_end', the rest of each line is
+// filled with bytes of 'alphabet'.
+static std::string make_lines(size_t line_size, std::string_view alphabet, std::string_view line_end)
+{
+	std::string data;
+	data.reserve(DATA_SIZE + line_size);
+	for (size_t i = 0; data.size() < DATA_SIZE; i++)
+	{
+		for (size_t j = 0; j + line_end.size() < line_size; j++)
+		{
+			data += alphabet[(i + j) % alphabet.size()];
+		}
+
+		data += line_end;
+	}
+
+	return data;
+}
+
+// Returns the best time of a pass over 'data' in nanoseconds. 'next'
+// returns the position after the found part or nullptr at the end.
+template <typename FunctionT>
+static long long time_pass(const std::string& data, FunctionT next)
+{
+	auto best_time = std::chrono::nanoseconds::max();
+	for (int run = 0; run < RUNS_COUNT; run++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		const char* position = data.data();
+		const char* end = position + data.size();
+		size_t count = 0;
+		while (position && position != end)
+		{
+			position = next(position, end);
+			count++;
+		}
+
+		auto time = std::chrono::steady_clock::now() - start;
+		asm volatile("" : : "r"(count) : "memory");
+		best_time = std::min(best_time, std::chrono::duration_cast<std::chrono::nanoseconds>(time));
+	}
+
+	return (long long)best_time.count();
+}
+
+// Skips the byte which ends a scanned part.
+template <typename FunctionT>
+static auto skipping(FunctionT function)
+{
+	return [function](const char* begin, const char* end) -> const char*
+	{
+		auto* result = function(begin, end);
+		return result == end ? nullptr : result + 1;
+	};
+}
+
+int main()
+{
+	const std::array<size_t, 5> line_sizes{16, 64, 256, 1024, 4096};
+	std::printf("Best time of a pass over %zu KiB of lines, ns\n\n", DATA_SIZE / 1024);
+	std::printf("%-32s", "line size");
+	for (auto size : line_sizes)
+	{
+		std::printf("%10zu", size);
+	}
+
+	std::printf("\n");
+	auto print_row = [&](const char* name, auto make_data, auto next)
+	{
+		std::printf("%-32s", name);
+		for (auto size : line_sizes)
+		{
+			std::printf("%10lld", time_pass(make_data(size), next));
+		}
+
+		std::printf("\n");
+	};
+
+	auto text_lines = [](size_t size) { return make_lines(size, "abcdefghij =;/", "\r\n"); };
+	print_row("find_line_end", text_lines, xw::server::util::find_line_end);
+	print_row("find_line_end, scalar", text_lines, find_line_end_scalar);
+	print_row("find(\"\\r\\n\")", text_lines, find_line_end_crlf);
+	print_row(
+		"find_byte", text_lines,
+		skipping([](const char* begin, const char* end) { return xw::server::util::find_byte(begin, end, '\n'); })
+	);
+	print_row(
+		"find_byte, scalar", text_lines,
+		skipping([](const char* begin, const char* end) { return find_byte_scalar(begin, end, '\n'); })
+	);
+
+	auto token_lines = [](size_t size) { return make_lines(size, "Accept-Encoding_x.42~", ":"); };
+	print_row("find_non_token", token_lines, skipping(xw::server::util::find_non_token));
+	print_row("find_non_token, scalar", token_lines, skipping(find_non_token_scalar));
+
+	auto value_lines = [](size_t size) { return make_lines(size, "text/html;q=0.9,*/*", "\r"); };
+	print_row(
+		"find_control", value_lines,
+		skipping([](const char* begin, const char* end) { return xw::server::util::find_control(begin, end, true); })
+	);
+	print_row("find_control, scalar", value_lines, skipping(find_control_scalar));
+	return 0;
+}
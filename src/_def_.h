@@ -18,6 +18,13 @@
 #define __SERVER_UTIL_BEGIN__ __SERVER_BEGIN__ namespace util {
 #define __SERVER_UTIL_END__ } __SERVER_END__
 
+// Coroutine request handlers require C++20 coroutines of the compiler,
+// e.g. GCC 10 with '-fcoroutines'. The synchronous server is built
+// without them.
+#if defined(__cpp_impl_coroutine)
+#define __SERVER_HAS_COROUTINES__
+#endif
+
 
 __SERVER_BEGIN__
 
@@ -0,0 +1,325 @@
+/**
+ * async_stream.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./async_stream.h"
+
+#if defined(__SERVER_HAS_COROUTINES__)
+
+// C++ libraries.
+#include <algorithm>
+#include <thread>
+#include <poll.h>
+
+// Server libraries.
+#include "./chunked_body.h"
+#include "./exceptions.h"
+#include "./sockets/io.h"
+
+
+__SERVER_BEGIN__
+
+void AsyncStream::Awaitable::await_resume() const
+{
+	if (this->stream->_is_expired && this->event.flags != SelectorEvent::None)
+	{
+		throw SocketError(ETIMEDOUT, "Connection timed out", _ERROR_DETAILS_);
+	}
+}
+
+AsyncStream::AsyncStream(io::ILimitedBufferedStream* stream) :
+	_stream(require_non_null(stream, "'stream' is nullptr", _ERROR_DETAILS_)),
+	_socket_io(dynamic_cast<SocketIO*>(stream)),
+	_chunked_body(nullptr),
+	_timeout(std::chrono::seconds(5)),
+	_read_timeout(std::chrono::milliseconds::zero()),
+	_write_timeout(std::chrono::milliseconds::zero()),
+	_read_deadline(std::chrono::steady_clock::time_point::max()),
+	_write_deadline(std::chrono::steady_clock::time_point::max()),
+	_is_expired(false)
+{
+	if (this->_socket_io)
+	{
+		auto timeout = this->_socket_io->timeout();
+		this->_timeout = std::chrono::seconds(timeout.tv_sec) + std::chrono::microseconds(timeout.tv_usec);
+	}
+}
+
+Coroutine<ssize_t> AsyncStream::read(std::string& destination, size_t max_count)
+{
+	destination.clear();
+	if (this->_chunked_body)
+	{
+		if (max_count > 0)
+		{
+			co_await this->_receive_chunk();
+		}
+
+		co_return this->_chunked_body->read(destination, max_count);
+	}
+
+	if (!this->_socket_io)
+	{
+		co_return this->_stream->read(destination, max_count);
+	}
+
+	while (max_count > 0 && this->_socket_io->buffered() == 0)
+	{
+		if (this->_socket_io->limit() == 0 || !this->_socket_io->read_available())
+		{
+			co_return 0;
+		}
+
+		if (this->_socket_io->buffered() == 0)
+		{
+			co_await this->readable();
+		}
+	}
+
+	// The buffer is not empty, so the socket is not touched.
+	co_return this->_socket_io->read(destination, max_count);
+}
+
+Coroutine<ssize_t> AsyncStream::read(std::span<char> destination)
+{
+	if (this->_chunked_body)
+	{
+		if (!destination.empty())
+		{
+			co_await this->_receive_chunk();
+		}
+
+		co_return this->_chunked_body->read(destination);
+	}
+
+	if (!this->_socket_io)
+	{
+		co_return read_into(this->_stream, destination);
+	}
+
+	while (true)
+	{
+		auto result = this->_socket_io->try_read(destination);
+		if (result >= 0)
+		{
+			co_return result;
+		}
+
+		co_await this->readable();
+	}
+}
+
+Coroutine<ssize_t> AsyncStream::write(const char* data, size_t count)
+{
+	if (!this->_socket_io)
+	{
+		co_return this->_stream->write(data, count);
+	}
+
+	if (this->_socket_io->buffer(data, count))
+	{
+		if (this->_socket_io->write_buffer_is_full())
+		{
+			co_await this->flush();
+		}
+
+		co_return (ssize_t)count;
+	}
+
+	size_t bytes_sent_count = 0;
+	while (true)
+	{
+		bytes_sent_count += this->_socket_io->try_write(data + bytes_sent_count, count - bytes_sent_count);
+		if (bytes_sent_count >= count)
+		{
+			break;
+		}
+
+		co_await this->writable();
+	}
+
+	co_return (ssize_t)bytes_sent_count;
+}
+
+Coroutine<ssize_t> AsyncStream::write(std::string data)
+{
+	co_return co_await this->write(data.data(), data.size());
+}
+
+Coroutine<void> AsyncStream::flush()
+{
+	if (!this->_socket_io)
+	{
+		flush_writes(this->_stream);
+		co_return;
+	}
+
+	while (this->_socket_io->has_pending_writes())
+	{
+		this->_socket_io->try_write(nullptr, 0);
+		if (this->_socket_io->has_pending_writes())
+		{
+			co_await this->writable();
+		}
+	}
+
+	// Nothing is left to send, only the cork is released.
+	this->_socket_io->flush();
+}
+
+Coroutine<ssize_t> AsyncStream::send_file(int file_descriptor, off_t offset, size_t count)
+{
+	if (!this->_socket_io)
+	{
+		co_return server::send_file(this->_stream, file_descriptor, offset, count);
+	}
+
+	size_t bytes_sent_count = 0;
+
+	// The event loop waits for the socket only, so the file is polled
+	// while it has no data, e.g. when it is a pipe.
+	auto source_delay = MIN_SOURCE_DELAY;
+	auto source_deadline = std::chrono::steady_clock::time_point::max();
+	while (bytes_sent_count < count)
+	{
+		auto result = this->_socket_io->try_send_file(
+			file_descriptor, offset < 0 ? offset : offset + (off_t)bytes_sent_count, count - bytes_sent_count
+		);
+		if (result == 0)
+		{
+			break;
+		}
+		else if (result > 0)
+		{
+			bytes_sent_count += result;
+			source_delay = MIN_SOURCE_DELAY;
+			source_deadline = std::chrono::steady_clock::time_point::max();
+		}
+		else if (errno == ENODATA)
+		{
+			if (source_deadline == std::chrono::steady_clock::time_point::max())
+			{
+				source_deadline = this->_deadline(this->_write_deadline, this->_write_timeout);
+			}
+			else if (std::chrono::steady_clock::now() >= source_deadline)
+			{
+				throw SocketError(ETIMEDOUT, "Connection timed out", _ERROR_DETAILS_);
+			}
+
+			co_await this->sleep_for(source_delay);
+			source_delay = std::min(source_delay * 2, MAX_SOURCE_DELAY);
+		}
+		else
+		{
+			co_await this->writable();
+		}
+	}
+
+	co_return (ssize_t)bytes_sent_count;
+}
+
+AsyncStream::Awaitable AsyncStream::readable()
+{
+	if (this->_socket_io && this->_socket_io->has_pending_writes())
+	{
+		// The peer may wait for queued responses before sending more.
+		this->_socket_io->try_write(nullptr, 0);
+	}
+
+	return {this, {.flags = SelectorEvent::Read, .deadline = this->_deadline(this->_read_deadline, this->_read_timeout)}};
+}
+
+AsyncStream::Awaitable AsyncStream::writable()
+{
+	return {
+		this, {.flags = SelectorEvent::Write, .deadline = this->_deadline(this->_write_deadline, this->_write_timeout)}
+	};
+}
+
+AsyncStream::Awaitable AsyncStream::sleep_for(std::chrono::steady_clock::duration duration)
+{
+	return {this, {.flags = SelectorEvent::None, .deadline = std::chrono::steady_clock::now() + duration}};
+}
+
+void AsyncStream::resume(bool is_expired)
+{
+	this->_is_expired = is_expired;
+	auto handle = std::exchange(this->_waiting_handle, {});
+	handle.resume();
+}
+
+bool AsyncStream::wait() const
+{
+	auto event = this->_awaited_event;
+	if (event.flags == SelectorEvent::None || !this->_socket_io)
+	{
+		std::this_thread::sleep_until(event.deadline);
+		return false;
+	}
+
+	pollfd descriptor{
+		.fd = this->_socket_io->file_descriptor(),
+		.events = (short)(
+			((event.flags & SelectorEvent::Read) ? POLLIN : 0) | ((event.flags & SelectorEvent::Write) ? POLLOUT : 0)
+		)
+	};
+	while (true)
+	{
+		auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+			event.deadline - std::chrono::steady_clock::now()
+		);
+		auto status = ::poll(&descriptor, 1, std::max((int)timeout.count(), 0));
+		if (status > 0)
+		{
+			return true;
+		}
+		else if (status == 0)
+		{
+			return false;
+		}
+		else if (errno != EINTR)
+		{
+			throw SocketError(errno, "'poll' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
+		}
+	}
+}
+
+Coroutine<void> AsyncStream::_receive_chunk()
+{
+	while (!this->_chunked_body->receive_framing())
+	{
+		if (!this->_socket_io->read_available())
+		{
+			co_return;
+		}
+
+		if (!this->_chunked_body->receive_framing())
+		{
+			co_await this->readable();
+		}
+	}
+}
+
+std::chrono::steady_clock::time_point AsyncStream::_deadline(
+	std::chrono::steady_clock::time_point& stage_deadline, std::chrono::milliseconds stage_timeout
+)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (stage_timeout == std::chrono::milliseconds::zero())
+	{
+		return now + this->_timeout;
+	}
+
+	if (stage_deadline == std::chrono::steady_clock::time_point::max())
+	{
+		stage_deadline = now + stage_timeout;
+	}
+
+	return stage_deadline;
+}
+
+__SERVER_END__
+
+#endif // __SERVER_HAS_COROUTINES__
@@ -0,0 +1,195 @@
+/**
+ * async_stream.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Awaitable I/O of a connection for coroutine request handlers.
+ */
+
+#pragma once
+
+// Module definitions.
+#include "./_def_.h"
+
+#if defined(__SERVER_HAS_COROUTINES__)
+
+// C++ libraries.
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <sys/types.h>
+
+// Base libraries.
+#include <xalwart.base/io.h>
+#include <xalwart.base/net/request_context.h>
+
+// Server libraries.
+#include "./interfaces.h"
+#include "./coroutines.h"
+
+
+__SERVER_BEGIN__
+
+class SocketIO;
+class ChunkedBodyReader;
+
+// TESTME: AsyncStream
+// Reads the request body and writes the response of a coroutine
+// handler. When the socket is not ready, the coroutine is suspended
+// and the event is reported to the request handler with
+// 'awaited_event', so the connection costs only the coroutine frame
+// until it is resumed.
+//
+// Streams which are not 'SocketIO' are used synchronously.
+class AsyncStream final
+{
+public:
+	// Suspends the coroutine until 'flags' events of the socket or the
+	// deadline. Throws 'SocketError' with 'ETIMEDOUT' if the deadline
+	// expires first and the awaitable waits for the socket.
+	struct Awaitable
+	{
+		AsyncStream* stream;
+		AwaitedEvent event;
+
+		[[nodiscard]]
+		inline bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		inline void await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			this->stream->_waiting_handle = handle;
+			this->stream->_awaited_event = this->event;
+		}
+
+		void await_resume() const;
+	};
+
+	explicit AsyncStream(io::ILimitedBufferedStream* stream);
+
+	// Limits all reads and all writes of a request instead of each of
+	// them. Zero keeps the timeout of the stream per operation.
+	inline void set_timeouts(std::chrono::milliseconds read_timeout, std::chrono::milliseconds write_timeout)
+	{
+		this->_read_timeout = read_timeout;
+		this->_write_timeout = write_timeout;
+	}
+
+	// Resets deadlines of the previous request. The body of the request
+	// is decoded by 'chunked_body' if it is set, as it is for handlers
+	// which read the body of the request context.
+	inline void begin_request(ChunkedBodyReader* chunked_body=nullptr)
+	{
+		this->_read_deadline = std::chrono::steady_clock::time_point::max();
+		this->_write_deadline = std::chrono::steady_clock::time_point::max();
+		this->_chunked_body = chunked_body;
+	}
+
+	// Reads up to 'max_count' bytes of the request. Returns zero when
+	// the connection or the limit of the stream is exhausted, or after
+	// the last chunk of a chunked body.
+	Coroutine<ssize_t> read(std::string& destination, size_t max_count);
+
+	// Reads up to 'destination.size()' bytes of the request directly to
+	// 'destination', which should be alive until the returned coroutine
+	// finishes. Returns zero at EOF or after the last chunk.
+	Coroutine<ssize_t> read(std::span<char> destination);
+
+	// Writes the whole 'data', which should be alive until the returned
+	// coroutine finishes. Writes shorter than the write buffer of the
+	// stream are queued and sent when the buffer is full.
+	Coroutine<ssize_t> write(const char* data, size_t count);
+
+	// Writes the whole 'data'.
+	Coroutine<ssize_t> write(std::string data);
+
+	// Sends data queued by writes.
+	Coroutine<void> flush();
+
+	// Sends 'count' bytes of the file from 'offset' as 'send_file' of
+	// 'SocketIO' does. Returns less than 'count' at the end of the file.
+	// Files without data, e.g. pipes, are checked again after growing
+	// delays until the write timeout.
+	Coroutine<ssize_t> send_file(int file_descriptor, off_t offset, size_t count);
+
+	// Waits for incoming data within the timeout of the stream.
+	Awaitable readable();
+
+	// Waits for space in the socket buffer within the timeout of the
+	// stream.
+	Awaitable writable();
+
+	// Suspends the coroutine for 'duration' without blocking the
+	// thread.
+	Awaitable sleep_for(std::chrono::steady_clock::duration duration);
+
+	[[nodiscard]]
+	inline bool is_suspended() const
+	{
+		return (bool)this->_waiting_handle;
+	}
+
+	[[nodiscard]]
+	inline AwaitedEvent awaited_event() const
+	{
+		return this->_awaited_event;
+	}
+
+	// Continues the innermost suspended coroutine.
+	void resume(bool is_expired);
+
+	// Blocks the calling thread until the awaited event or its deadline.
+	// Returns false if the deadline expires first.
+	//
+	// Used when the request is handled without an event loop.
+	bool wait() const;
+
+private:
+	// Bounds of the delay between checks of a sent file without data.
+	static constexpr std::chrono::milliseconds MIN_SOURCE_DELAY{1};
+	static constexpr std::chrono::milliseconds MAX_SOURCE_DELAY{64};
+
+	io::ILimitedBufferedStream* _stream;
+
+	// Non-blocking operations are available for sockets only.
+	SocketIO* _socket_io;
+
+	// Decoder of the body of the current request if it is chunked.
+	ChunkedBodyReader* _chunked_body;
+
+	std::chrono::steady_clock::duration _timeout;
+	std::chrono::milliseconds _read_timeout;
+	std::chrono::milliseconds _write_timeout;
+
+	// Set by the first wait of the request.
+	std::chrono::steady_clock::time_point _read_deadline;
+	std::chrono::steady_clock::time_point _write_deadline;
+	std::coroutine_handle<> _waiting_handle;
+	AwaitedEvent _awaited_event;
+	bool _is_expired;
+
+	// Waits until the framing of the chunked body is received up to the
+	// data of the next chunk, so the decoder does not block. Returns at
+	// EOF as well, then the decoder throws 'EoF'.
+	Coroutine<void> _receive_chunk();
+
+	[[nodiscard]]
+	std::chrono::steady_clock::time_point _deadline(
+		std::chrono::steady_clock::time_point& stage_deadline, std::chrono::milliseconds stage_timeout
+	);
+};
+
+using CoroutineHandlerFunction = std::function<Coroutine<net::StatusCode>(
+	net::RequestContext* /* context */,
+	const std::map<std::string, std::string>& /* environment */,
+	AsyncStream* /* stream */
+)>;
+
+__SERVER_END__
+
+#endif // __SERVER_HAS_COROUTINES__
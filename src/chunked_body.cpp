@@ -0,0 +1,392 @@
+/**
+ * chunked_body.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./chunked_body.h"
+
+// C++ libraries.
+#include <algorithm>
+#include <cstring>
+
+// Server libraries.
+#include "./exceptions.h"
+#include "./sockets/io.h"
+
+
+__SERVER_BEGIN__
+
+// Returns the value of a hexadecimal digit or -1.
+static inline int hex_digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+
+	c = (char)(c | 0x20);
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+
+	return -1;
+}
+
+// Removes "\r\n" or "\n" at the end of 'line'. Returns false if there
+// is no line break.
+static inline bool remove_line_break(std::string_view& line)
+{
+	if (line.empty() || line.back() != '\n')
+	{
+		return false;
+	}
+
+	line.remove_suffix(1);
+	if (!line.empty() && line.back() == '\r')
+	{
+		line.remove_suffix(1);
+	}
+
+	return true;
+}
+
+ChunkedBodyReader::ChunkedBodyReader(
+	std::shared_ptr<io::ILimitedBufferedStream> stream,
+	size_t max_line_length, size_t max_trailers_count, size_t max_body_size
+) : _stream(std::move(stream)),
+    _trailer_parser(max_line_length, max_trailers_count),
+    _max_body_size(max_body_size == 0 ? SIZE_MAX : max_body_size),
+    _state(State::Size),
+    _chunk_left(0),
+    _body_size(0)
+{
+	require_non_null(this->_stream.get(), "'stream' is nullptr", _ERROR_DETAILS_);
+	this->_socket_io = dynamic_cast<SocketIO*>(this->_stream.get());
+}
+
+void ChunkedBodyReader::reset()
+{
+	this->_state = State::Size;
+	this->_chunk_left = 0;
+	this->_body_size = 0;
+	this->_trailer_fields.clear();
+	this->_trailers.clear();
+}
+
+ssize_t ChunkedBodyReader::read_line(std::string& line)
+{
+	line.clear();
+	while (this->next_chunk() > 0)
+	{
+		auto part = this->read_chunk_data(this->_chunk_left, true);
+		line.append(part);
+		if (part.back() == '\n')
+		{
+			break;
+		}
+	}
+
+	return (ssize_t)line.size();
+}
+
+ssize_t ChunkedBodyReader::read(std::string& buffer, size_t max_count)
+{
+	buffer.clear();
+	if (max_count == 0 || this->next_chunk() == 0)
+	{
+		return 0;
+	}
+
+	buffer.append(this->read_chunk_data(max_count));
+	return (ssize_t)buffer.size();
+}
+
+ssize_t ChunkedBodyReader::read(std::string_view& data, size_t max_count)
+{
+	data = {};
+	if (max_count == 0 || this->next_chunk() == 0)
+	{
+		return 0;
+	}
+
+	data = this->read_chunk_data(max_count);
+	return (ssize_t)data.size();
+}
+
+ssize_t ChunkedBodyReader::read(std::span<char> destination)
+{
+	if (destination.empty() || this->next_chunk() == 0)
+	{
+		return 0;
+	}
+
+	auto count = std::min(destination.size(), this->_chunk_left);
+	if (!this->_socket_io)
+	{
+		auto data = this->read_chunk_data(count);
+		std::memcpy(destination.data(), data.data(), data.size());
+		return (ssize_t)data.size();
+	}
+
+	// Large reads receive the data from the socket directly.
+	auto read_count = this->_socket_io->read(destination.first(count));
+	if (read_count <= 0)
+	{
+		throw EoF("end of stream before the last chunk", _ERROR_DETAILS_);
+	}
+
+	this->advance(read_count);
+	return read_count;
+}
+
+ssize_t ChunkedBodyReader::peek(std::string& buffer, size_t max_count)
+{
+	buffer.clear();
+	if (max_count == 0 || this->next_chunk() == 0)
+	{
+		return 0;
+	}
+
+	return this->_stream->peek(buffer, std::min(max_count, this->_chunk_left));
+}
+
+ssize_t ChunkedBodyReader::buffered() const
+{
+	if (this->_state != State::Data)
+	{
+		return 0;
+	}
+
+	return (ssize_t)std::min(this->_chunk_left, (size_t)std::max(this->_stream->buffered(), (ssize_t)0));
+}
+
+void ChunkedBodyReader::set_limit(ssize_t limit)
+{
+	this->_max_body_size = limit < 0 ? SIZE_MAX : this->_body_size - this->_chunk_left + limit;
+}
+
+ssize_t ChunkedBodyReader::limit() const
+{
+	if (this->_max_body_size == SIZE_MAX)
+	{
+		return -1;
+	}
+
+	return (ssize_t)(this->_max_body_size - (this->_body_size - this->_chunk_left));
+}
+
+bool ChunkedBodyReader::receive_framing()
+{
+	if (!this->_socket_io)
+	{
+		return true;
+	}
+
+	while (this->_state != State::Data && this->_state != State::Finished)
+	{
+		if (!this->_socket_io->has_buffered_line(this->framing_line_limit()))
+		{
+			return false;
+		}
+
+		this->read_framing();
+	}
+
+	return this->_state == State::Finished || this->_socket_io->buffered() > 0;
+}
+
+size_t ChunkedBodyReader::next_chunk()
+{
+	while (this->_state != State::Data && this->_state != State::Finished)
+	{
+		this->read_framing();
+	}
+
+	return this->_state == State::Data ? this->_chunk_left : 0;
+}
+
+void ChunkedBodyReader::read_framing()
+{
+	auto line = this->read_framing_line(this->framing_line_limit());
+	switch (this->_state)
+	{
+		case State::Size:
+			this->parse_chunk_size(line);
+			break;
+		case State::DataEnd:
+			if (!remove_line_break(line) || !line.empty())
+			{
+				throw ParseError("Bad end of chunk data", _ERROR_DETAILS_);
+			}
+
+			this->_state = State::Size;
+			break;
+		case State::Trailers:
+			this->parse_trailer_field(line);
+			break;
+		default:
+			break;
+	}
+}
+
+size_t ChunkedBodyReader::framing_line_limit() const
+{
+	// Only the line break is expected after the data of a chunk.
+	return this->_state == State::DataEnd ? 2 : this->_trailer_parser.max_line_length();
+}
+
+std::string_view ChunkedBodyReader::read_framing_line(size_t max_count)
+{
+	std::string_view line;
+	if (this->_socket_io)
+	{
+		this->_socket_io->read_line(line, max_count);
+	}
+	else
+	{
+		this->_stream->read_line(this->_buffer);
+		line = std::string_view(this->_buffer).substr(0, max_count);
+	}
+
+	// A longer line is left to the caller.
+	if (line.size() < max_count && (line.empty() || line.back() != '\n'))
+	{
+		throw EoF("end of stream before the last chunk", _ERROR_DETAILS_);
+	}
+
+	return line;
+}
+
+void ChunkedBodyReader::parse_chunk_size(std::string_view line)
+{
+	if (!remove_line_break(line))
+	{
+		throw LineTooLongError("chunk size line", _ERROR_DETAILS_);
+	}
+
+	size_t size = 0;
+	size_t position = 0;
+	for (int digit; position < line.size() && (digit = hex_digit_value(line[position])) >= 0; position++)
+	{
+		if (size > (SIZE_MAX >> 4))
+		{
+			throw ParseError("Chunk size is too large", _ERROR_DETAILS_);
+		}
+
+		size = (size << 4) | digit;
+	}
+
+	if (position == 0)
+	{
+		throw ParseError("Bad chunk size line", _ERROR_DETAILS_);
+	}
+
+	// Extensions follow the size after optional whitespace and are
+	// skipped, see RFC 7230, section 4.1.1.
+	auto rest = line.substr(position);
+	while (!rest.empty() && (rest.front() == ' ' || rest.front() == '\t'))
+	{
+		rest.remove_prefix(1);
+	}
+
+	if (!rest.empty())
+	{
+		auto is_control = [](char c) { return ((unsigned char)c < 0x20 && c != '\t') || c == 0x7f; };
+		if (rest.front() != ';' || std::any_of(rest.begin(), rest.end(), is_control))
+		{
+			throw ParseError("Bad chunk size line", _ERROR_DETAILS_);
+		}
+	}
+
+	if (size == 0)
+	{
+		this->_state = State::Trailers;
+		return;
+	}
+
+	// The limit may be set below the size of the started chunks.
+	if (this->_body_size > this->_max_body_size || size > this->_max_body_size - this->_body_size)
+	{
+		throw BodyTooLargeError(
+			"chunked body exceeds " + std::to_string(this->_max_body_size) + " bytes", _ERROR_DETAILS_
+		);
+	}
+
+	this->_body_size += size;
+	this->_chunk_left = size;
+	this->_state = State::Data;
+}
+
+void ChunkedBodyReader::parse_trailer_field(std::string_view line)
+{
+	if (line.back() != '\n')
+	{
+		throw LineTooLongError("trailer line", _ERROR_DETAILS_);
+	}
+
+	bool is_end;
+	auto count = this->_trailer_parser.parse_header_line(line, 0, this->_trailer_fields, is_end);
+	if (count != line.size())
+	{
+		throw ParseError("Bad trailer line", _ERROR_DETAILS_);
+	}
+
+	if (is_end)
+	{
+		this->_state = State::Finished;
+		return;
+	}
+
+	// The line is valid until the next read.
+	const auto& field = this->_trailer_fields.headers.back();
+	auto value = field.value.in(line);
+	auto [position, is_inserted] = this->_trailers.try_emplace(std::string(field.name.in(line)), value);
+	if (!is_inserted)
+	{
+		position->second.append(", ").append(value);
+	}
+}
+
+std::string_view ChunkedBodyReader::read_chunk_data(size_t max_count, bool is_line)
+{
+	auto count = std::min(max_count, this->_chunk_left);
+	std::string_view data;
+	if (this->_socket_io)
+	{
+		if (is_line)
+		{
+			this->_socket_io->read_line(data, count);
+		}
+		else
+		{
+			this->_socket_io->read(data, count);
+		}
+	}
+	else
+	{
+		// Lines are read by bytes, so the next chunk is not consumed.
+		this->_stream->read(this->_buffer, is_line ? 1 : count);
+		data = this->_buffer;
+	}
+
+	if (data.empty())
+	{
+		throw EoF("end of stream before the last chunk", _ERROR_DETAILS_);
+	}
+
+	this->advance(data.size());
+	return data;
+}
+
+void ChunkedBodyReader::advance(size_t count)
+{
+	this->_chunk_left -= count;
+	if (this->_chunk_left == 0)
+	{
+		this->_state = State::DataEnd;
+	}
+}
+
+__SERVER_END__
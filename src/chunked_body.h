@@ -0,0 +1,198 @@
+/**
+ * chunked_body.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Reader of request bodies with chunked transfer coding.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+// Base libraries.
+#include <xalwart.base/io.h>
+
+// Module definitions.
+#include "./_def_.h"
+
+// Server libraries.
+#include "./request_parser.h"
+
+
+__SERVER_BEGIN__
+
+class SocketIO;
+
+// TESTME: ChunkedBodyReader
+// Decodes a body with chunked transfer coding while it is read from the
+// connection, see RFC 7230, section 4.1. Handlers receive it as the body
+// of the request context and read the data of chunks only, 'read'
+// returns zero after the last chunk.
+//
+// With 'SocketIO' the data is returned from the buffer of the
+// connection between lines of the framing, so it is not copied, and
+// large reads to the caller's memory receive it from the socket
+// directly. Chunk extensions are skipped. Trailer fields are collected
+// after the last chunk, see 'trailers'.
+//
+// Malformed framing throws 'ParseError', a line longer than its limit
+// 'LineTooLongError', too many trailer fields 'TooMuchHeadersError' and
+// a body larger than its limit 'BodyTooLargeError'. A connection closed
+// before the last chunk throws 'EoF'.
+class ChunkedBodyReader final : public io::ILimitedBufferedStream
+{
+public:
+	// Lines of the framing and trailer fields are limited as lines and
+	// fields of the head. Zero 'max_body_size' means no limit.
+	explicit ChunkedBodyReader(
+		std::shared_ptr<io::ILimitedBufferedStream> stream,
+		size_t max_line_length, size_t max_trailers_count, size_t max_body_size=0
+	);
+
+	// Prepares the reader for the next body of the same stream.
+	void reset();
+
+	ssize_t read_line(std::string& line) override;
+
+	// Reads up to 'max_count' bytes of the data of the current chunk.
+	ssize_t read(std::string& buffer, size_t max_count) override;
+
+	// Reads up to 'max_count' bytes of the data of the current chunk
+	// without copying them if the stream is 'SocketIO'. 'data' is valid
+	// until the next read.
+	ssize_t read(std::string_view& data, size_t max_count);
+
+	// Reads up to 'destination.size()' bytes of the data of the current
+	// chunk to 'destination'.
+	ssize_t read(std::span<char> destination);
+
+	ssize_t peek(std::string& buffer, size_t max_count) override;
+
+	inline ssize_t write(const char* data, size_t count) override
+	{
+		return this->_stream->write(data, count);
+	}
+
+	// Data of the current chunk which is already received.
+	[[nodiscard]]
+	ssize_t buffered() const override;
+
+	inline bool close_reader() override
+	{
+		return this->_stream->close_reader();
+	}
+
+	inline bool close_writer() override
+	{
+		return this->_stream->close_writer();
+	}
+
+	// Limits the count of bytes of the body which are not read yet,
+	// negative 'limit' removes the limit.
+	void set_limit(ssize_t limit) override;
+
+	[[nodiscard]]
+	ssize_t limit() const override;
+
+	// Reads the framing which is already received up to the data of the
+	// next chunk without waiting for the connection. Returns true if the
+	// next read does not wait: data of the chunk is received or the body
+	// is finished. Streams which are not 'SocketIO' are always ready,
+	// they are read synchronously.
+	//
+	// Used by coroutine handlers, which wait for the connection instead.
+	bool receive_framing();
+
+	// True after the last chunk and the trailer are read.
+	[[nodiscard]]
+	inline bool is_finished() const
+	{
+		return this->_state == State::Finished;
+	}
+
+	// Total size of chunks which are started so far.
+	[[nodiscard]]
+	inline size_t body_size() const
+	{
+		return this->_body_size;
+	}
+
+	// Trailer fields, complete when the reader is finished. Values of
+	// repeated fields are combined by ", ".
+	[[nodiscard]]
+	inline const std::map<std::string, std::string>& trailers() const
+	{
+		return this->_trailers;
+	}
+
+private:
+	enum class State
+	{
+		Size,
+		Data,
+		DataEnd,
+		Trailers,
+		Finished
+	};
+
+	std::shared_ptr<io::ILimitedBufferedStream> _stream;
+
+	// Lines and data are read without copying from sockets only.
+	SocketIO* _socket_io;
+
+	// Parses and limits trailer fields as header fields.
+	RequestParser _trailer_parser;
+	ParsedRequest _trailer_fields;
+
+	// 'SIZE_MAX' if the body is not limited.
+	size_t _max_body_size;
+
+	State _state;
+
+	// Data of the current chunk which is not read yet.
+	size_t _chunk_left;
+
+	size_t _body_size;
+
+	std::map<std::string, std::string> _trailers;
+
+	// Holds lines and data read from streams which are not sockets.
+	std::string _buffer;
+
+	// Reads the framing up to the data of the next chunk. Returns the
+	// count of bytes which are left in the chunk, zero at the end of the
+	// body.
+	size_t next_chunk();
+
+	// Reads a single line of the framing in the current state, which
+	// should be neither 'Data' nor 'Finished'.
+	void read_framing();
+
+	// Limit of the next line of the framing.
+	[[nodiscard]]
+	size_t framing_line_limit() const;
+
+	// Reads a line of the framing, at most 'max_count' bytes of it.
+	std::string_view read_framing_line(size_t max_count);
+
+	void parse_chunk_size(std::string_view line);
+
+	void parse_trailer_field(std::string_view line);
+
+	// Reads up to 'max_count' bytes of the current chunk, which should
+	// have data left, or up to '\n' if 'is_line' is set.
+	std::string_view read_chunk_data(size_t max_count, bool is_line=false);
+
+	// Marks 'count' bytes of the current chunk as read.
+	void advance(size_t count);
+};
+
+__SERVER_END__
@@ -11,6 +11,7 @@
 
 // Server libraries.
 #include "./selectors.h"
+#include "./uring.h"
 #include "./sockets/io.h"
 #include "./handlers/http_handler.h"
 
@@ -19,10 +20,27 @@ __SERVER_BEGIN__
 
 void Context::set_defaults()
 {
+	auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::seconds(this->timeout_seconds) + std::chrono::microseconds(this->timeout_microseconds)
+	);
+	if (this->stage_timeouts.idle == std::chrono::milliseconds::zero())
+	{
+		this->stage_timeouts.idle = timeout;
+	}
+
+	if (this->stage_timeouts.header_read == std::chrono::milliseconds::zero())
+	{
+		this->stage_timeouts.header_read = timeout;
+	}
+
 	if (!this->create_selector)
 	{
 		this->create_selector = [](const Context& context, Socket socket) -> std::unique_ptr<ISelector> {
+#if defined(__linux__) || defined(__APPLE__)
+			return std::make_unique<PollSelector>(socket, context.logger);
+#else
 			return std::make_unique<Selector>(socket, context.logger);
+#endif
 		};
 	}
 
@@ -34,11 +52,30 @@ void Context::set_defaults()
 			const std::map<std::string, std::string>& environment
 		) -> std::unique_ptr<IRequestHandler> {
 			require_non_null(stream.get(), "'stream' is nullptr", _ERROR_DETAILS_);
-			return std::make_unique<HTTPRequestHandler>(
-				std::move(stream), v::version.to_string(),
-				context.max_header_length, context.max_headers_count,
-				context.logger, environment, context.handler
-			);
+			std::unique_ptr<HTTPRequestHandler> handler;
+#if defined(__SERVER_HAS_COROUTINES__)
+			if (context.coroutine_handler)
+			{
+				handler = std::make_unique<HTTPRequestHandler>(
+					std::move(stream), v::version.to_string(),
+					context.max_header_length, context.max_headers_count,
+					context.logger, environment, context.coroutine_handler
+				);
+			}
+			else
+#endif
+			{
+				handler = std::make_unique<HTTPRequestHandler>(
+					std::move(stream), v::version.to_string(),
+					context.max_header_length, context.max_headers_count,
+					context.logger, environment, context.handler
+				);
+			}
+
+			handler->set_timeouts(context.stage_timeouts);
+			handler->set_copy_headers(context.copy_headers);
+			handler->set_max_chunked_body_size(context.max_chunked_body_size);
+			return handler;
 		};
 	}
 
@@ -49,17 +86,40 @@ void Context::set_defaults()
 				.tv_sec = context.timeout_seconds,
 				.tv_usec = (int)context.timeout_microseconds
 			};
-			return std::make_unique<SocketIO>(socket, timeout, context.create_selector(context, socket));
+#if defined(__linux__)
+			if (context.io_backend == IOBackend::IOUring)
+			{
+				auto* ring = IOUring::for_current_thread(context.io_uring_entries, context.logger);
+				if (ring)
+				{
+					auto stream = std::make_unique<SocketIO>(socket, timeout, ring);
+					stream->set_options(context.socket_options);
+					return stream;
+				}
+			}
+#endif
+			auto stream = std::make_unique<SocketIO>(socket, timeout, context.create_selector(context, socket));
+			stream->set_options(context.socket_options);
+			stream->set_zero_copy_threshold(context.zero_copy_threshold);
+			stream->set_write_buffer_size(context.write_buffer_size);
+			return stream;
 		};
 	}
 }
 
-void Context::validate() const
+void Context::validate(bool requires_worker) const
 {
 	require_non_null(this->logger, "'logger' is nullptr", _ERROR_DETAILS_);
 	require_non_null(this->timezone.get(), "'timezone' is nullptr", _ERROR_DETAILS_);
-	require_non_null(this->worker.get(), "'worker' is nullptr", _ERROR_DETAILS_);
-	if (!this->handler)
+	if (requires_worker)
+	{
+		require_non_null(this->worker.get(), "'worker' is nullptr", _ERROR_DETAILS_);
+	}
+	auto has_handler = (bool)this->handler;
+#if defined(__SERVER_HAS_COROUTINES__)
+	has_handler = has_handler || this->coroutine_handler;
+#endif
+	if (!has_handler)
 	{
 		throw NullPointerException("'handler' function is nullptr", _ERROR_DETAILS_);
 	}
@@ -78,6 +138,16 @@ void Context::validate() const
 	{
 		throw NullPointerException("'create_stream' function is nullptr", _ERROR_DETAILS_);
 	}
+
+	if (
+		this->connections_high_watermark > 0 &&
+		this->connections_low_watermark > this->connections_high_watermark
+	)
+	{
+		throw ArgumentError(
+			"'connections_low_watermark' should not exceed 'connections_high_watermark'", _ERROR_DETAILS_
+		);
+	}
 }
 
 __SERVER_END__
@@ -27,10 +27,23 @@
 
 // Server libraries.
 #include "./interfaces.h"
+#include "./async_stream.h"
 
 
 __SERVER_BEGIN__
 
+// Mechanism used to wait for and perform socket I/O.
+enum class IOBackend
+{
+	// 'ISelector' created by 'Context::create_selector' and plain
+	// system calls per operation.
+	Selector,
+
+	// Linux 'io_uring' submissions batched per thread. The server
+	// falls back to 'Selector' if the ring can not be created.
+	IOUring
+};
+
 // TESTME: Context
 // TODO: docs for 'Context'
 struct Context final
@@ -41,13 +54,86 @@ struct Context final
 	size_t max_header_length = 65535;
 	time_t timeout_seconds = 5;
 	time_t timeout_microseconds = 0;
+
+	// Zero 'idle' and 'header_read' are set to the timeout of a single
+	// operation by 'set_defaults'. Body and write stages are not limited
+	// by default, so large requests and responses are not cut off,
+	// except for synchronous handlers of 'ShardedHTTPServer'.
+	StageTimeouts stage_timeouts;
+
 	size_t socket_creation_retries_count = 5;
+
+	// Maximum count of connections accepted at a single wakeup of the
+	// accept loop and passed to the worker as a single task.
+	size_t accept_batch_size = 64;
+
+	// Accepting stops when the count of open client connections reaches
+	// the high watermark and continues when it drops to the low one.
+	// Zero values are derived from 'RLIMIT_NOFILE'.
+	size_t connections_high_watermark = 0;
+	size_t connections_low_watermark = 0;
+
+	IOBackend io_backend = IOBackend::Selector;
+	unsigned int io_uring_entries = 256;
+
+	// Keep connections in an event loop while they are idle or receive
+	// request headers instead of blocking a worker thread for the whole
+	// connection life time. Linux only; streams are created from
+	// 'create_selector' directly, 'create_stream' is not used.
+	bool use_reactor = false;
+
+	// Count of listening sockets bound to the same address with
+	// 'SO_REUSEPORT', each served by its own acceptor thread, so the
+	// kernel balances incoming connections between them. Zero means one
+	// per CPU core. Unix sockets always use a single acceptor. For
+	// 'ShardedHTTPServer' it is the count of shards.
+	size_t acceptors_count = 1;
+
+	// Linux only: pass each connection to the acceptor with the index
+	// of the CPU which received it. Acceptor threads are pinned to the
+	// corresponding CPUs.
+	bool steer_connections_by_cpu = false;
+
+	// Applied to listening sockets by 'bind' of servers and to accepted
+	// connections by streams.
+	SocketOptions socket_options;
+
+	// Linux only: writes of at least this count of bytes are sent with
+	// 'MSG_ZEROCOPY' instead of being copied to the socket buffer. Each
+	// such write waits until the peer acknowledges the data, so it pays
+	// off for multi-megabyte bodies only. Zero disables it.
+	size_t zero_copy_threshold = 0;
+
+	// Response writes shorter than this count of bytes are collected
+	// and sent when they reach it, on an explicit flush or at the end
+	// of the request, so handlers which write many small pieces do not
+	// make a system call per piece. Zero sends each write immediately.
+	// Not used with 'IOBackend::IOUring', which batches all writes.
+	size_t write_buffer_size = 0;
+
+	// Handlers always receive header fields as views of the request head,
+	// see 'header_table'. If it is not set, they are not copied to the
+	// map of the request context, which saves allocations per header.
+	bool copy_headers = true;
+
+	// Bodies with chunked transfer coding are decoded while handlers
+	// read them from the request context, their lines are limited as
+	// header lines. Reading a body which exceeds this count of bytes
+	// throws 'BodyTooLargeError'. Zero means no limit.
+	size_t max_chunked_body_size = 0;
 	std::unique_ptr<AbstractWorker> worker = nullptr;
 
 	std::function<net::StatusCode(
 		net::RequestContext* /* context */, const std::map<std::string, std::string>& /* environment */
 	)> handler = nullptr;
 
+#if defined(__SERVER_HAS_COROUTINES__)
+	// Used instead of 'handler' if set. The coroutine is suspended while
+	// the connection is not ready, so with 'use_reactor' a slow client
+	// does not occupy a worker thread.
+	CoroutineHandlerFunction coroutine_handler = nullptr;
+#endif
+
 	std::function<std::unique_ptr<ISelector>(const Context& context, Socket)> create_selector = nullptr;
 
 	std::function<std::unique_ptr<IRequestHandler>(
@@ -60,7 +146,9 @@ struct Context final
 
 	void set_defaults();
 
-	void validate() const;
+	// 'worker' is optional for servers which process requests on
+	// their own threads.
+	void validate(bool requires_worker=true) const;
 };
 
 __SERVER_END__
@@ -0,0 +1,237 @@
+/**
+ * coroutines.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Coroutine type for asynchronous request handlers.
+ */
+
+#pragma once
+
+// Module definitions.
+#include "./_def_.h"
+
+#if defined(__SERVER_HAS_COROUTINES__)
+
+// C++ libraries.
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+
+__SERVER_BEGIN__
+
+template <typename ResultT>
+class Coroutine;
+
+namespace internal
+{
+
+template <typename ResultT>
+struct BasePromise
+{
+	std::exception_ptr exception;
+
+	// Coroutine which awaits this one.
+	std::coroutine_handle<> continuation;
+
+	struct FinalAwaiter
+	{
+		[[nodiscard]]
+		inline bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		// Transfers control to the awaiting coroutine, so nested calls
+		// do not grow the stack.
+		template <typename PromiseT>
+		inline std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseT> handle) noexcept
+		{
+			auto continuation = handle.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		inline void await_resume() const noexcept
+		{
+		}
+	};
+
+	inline std::suspend_always initial_suspend() const noexcept
+	{
+		return {};
+	}
+
+	inline FinalAwaiter final_suspend() const noexcept
+	{
+		return {};
+	}
+
+	inline void unhandled_exception()
+	{
+		this->exception = std::current_exception();
+	}
+
+	inline void rethrow_if_failed() const
+	{
+		if (this->exception)
+		{
+			std::rethrow_exception(this->exception);
+		}
+	}
+};
+
+template <typename ResultT>
+struct Promise : public BasePromise<ResultT>
+{
+	std::optional<ResultT> value;
+
+	inline Coroutine<ResultT> get_return_object();
+
+	inline void return_value(ResultT result)
+	{
+		this->value = std::move(result);
+	}
+
+	inline ResultT result()
+	{
+		this->rethrow_if_failed();
+		return std::move(*this->value);
+	}
+};
+
+template <>
+struct Promise<void> : public BasePromise<void>
+{
+	inline Coroutine<void> get_return_object();
+
+	inline void return_void() const noexcept
+	{
+	}
+
+	inline void result() const
+	{
+		this->rethrow_if_failed();
+	}
+};
+
+};
+
+// TESTME: Coroutine
+// Lazily started coroutine which owns its frame. It can be awaited by
+// another coroutine or driven by a caller with 'start' and 'done'.
+//
+// Coroutines are suspended only by awaitables of 'AsyncStream' and
+// resumed by the code which handles the request: the reactor when the
+// awaited event occurs, or the thread itself otherwise.
+template <typename ResultT>
+class Coroutine final
+{
+public:
+	using promise_type = internal::Promise<ResultT>;
+
+	inline Coroutine() = default;
+
+	explicit inline Coroutine(std::coroutine_handle<promise_type> handle) : _handle(handle)
+	{
+	}
+
+	inline Coroutine(Coroutine&& other) noexcept : _handle(std::exchange(other._handle, {}))
+	{
+	}
+
+	inline Coroutine& operator= (Coroutine&& other) noexcept
+	{
+		if (this != &other)
+		{
+			this->_destroy();
+			this->_handle = std::exchange(other._handle, {});
+		}
+
+		return *this;
+	}
+
+	Coroutine(const Coroutine&) = delete;
+
+	Coroutine& operator= (const Coroutine&) = delete;
+
+	inline ~Coroutine()
+	{
+		this->_destroy();
+	}
+
+	[[nodiscard]]
+	inline bool is_valid() const
+	{
+		return (bool)this->_handle;
+	}
+
+	// Runs the coroutine until its first suspension.
+	inline void start()
+	{
+		this->_handle.resume();
+	}
+
+	[[nodiscard]]
+	inline bool done() const
+	{
+		return this->_handle.done();
+	}
+
+	// Returns the result of the finished coroutine or rethrows its
+	// exception.
+	inline ResultT result()
+	{
+		return this->_handle.promise().result();
+	}
+
+	[[nodiscard]]
+	inline bool await_ready() const noexcept
+	{
+		return !this->_handle || this->_handle.done();
+	}
+
+	inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		this->_handle.promise().continuation = awaiting;
+		return this->_handle;
+	}
+
+	inline ResultT await_resume()
+	{
+		return this->result();
+	}
+
+private:
+	std::coroutine_handle<promise_type> _handle;
+
+	inline void _destroy()
+	{
+		if (this->_handle)
+		{
+			this->_handle.destroy();
+			this->_handle = {};
+		}
+	}
+};
+
+namespace internal
+{
+
+template <typename ResultT>
+inline Coroutine<ResultT> Promise<ResultT>::get_return_object()
+{
+	return Coroutine<ResultT>(std::coroutine_handle<Promise<ResultT>>::from_promise(*this));
+}
+
+inline Coroutine<void> Promise<void>::get_return_object()
+{
+	return Coroutine<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+};
+
+__SERVER_END__
+
+#endif // __SERVER_HAS_COROUTINES__
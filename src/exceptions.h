@@ -62,4 +62,22 @@ public:
 	}
 };
 
+// Thrown when a request body exceeds its limit while it is read.
+class BodyTooLargeError : public ServerError
+{
+protected:
+	inline BodyTooLargeError(
+		const char* message, int line, const char* function, const char* file, const char* type
+	) : ServerError(message, line, function, file, type)
+	{
+	}
+
+public:
+	inline explicit BodyTooLargeError(
+		const std::string& message, int line=0, const char* function="", const char* file=""
+	) : BodyTooLargeError(message.c_str(), line, function, file, "xw::server::BodyTooLargeError")
+	{
+	}
+};
+
 __SERVER_END__
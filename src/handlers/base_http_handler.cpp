@@ -10,26 +10,115 @@
 #include <xalwart.base/net/status.h>
 #include <xalwart.base/net/utility.h>
 #include <xalwart.base/encoding.h>
-#include <xalwart.base/string_utils.h>
 #include <xalwart.base/html.h>
 #include <xalwart.base/datetime.h>
 
 // Server libraries.
 #include "../exceptions.h"
+#include "../sockets/io.h"
 
 
 __SERVER_BEGIN__
 
+BaseHTTPRequestHandler::BaseHTTPRequestHandler(
+	std::unique_ptr<io::ILimitedBufferedStream> stream,
+	size_t max_header_length, size_t max_headers_count,
+	std::string server_version, xw::ILogger* logger,
+	std::map<std::string, std::string> environment
+) : logger(logger),
+    stream(std::move(stream)),
+    socket_io(dynamic_cast<SocketIO*>(this->stream.get())),
+    head_parser(max_header_length, max_headers_count),
+    max_header_length(max_header_length),
+    max_headers_count(max_headers_count),
+    server_version_number(std::move(server_version)),
+    close_connection(false),
+    request_is_parsed(false),
+    environment(std::move(environment)),
+    total_bytes_read_count(0)
+{
+	if (this->socket_io)
+	{
+		this->socket_io->set_head_limits(max_header_length, max_headers_count);
+	}
+}
+
+BaseHTTPRequestHandler::BaseHTTPRequestHandler(
+	std::unique_ptr<io::ILimitedBufferedStream> stream,
+	size_t max_header_length, size_t max_headers_count,
+	std::string server_version, xw::ILogger* logger,
+	std::map<std::string, std::string> environment,
+	HandlerFunction handler_function
+) : BaseHTTPRequestHandler(
+		std::move(stream), max_header_length, max_headers_count, std::move(server_version),
+		logger, std::move(environment)
+	)
+{
+	if (!handler_function)
+	{
+		throw NullPointerException("'handler_function' is nullptr", _ERROR_DETAILS_);
+	}
+
+	this->handler_function = std::move(handler_function);
+}
+
+#if defined(__SERVER_HAS_COROUTINES__)
+BaseHTTPRequestHandler::BaseHTTPRequestHandler(
+	std::unique_ptr<io::ILimitedBufferedStream> stream,
+	size_t max_header_length, size_t max_headers_count,
+	std::string server_version, xw::ILogger* logger,
+	std::map<std::string, std::string> environment,
+	CoroutineHandlerFunction coroutine_function
+) : BaseHTTPRequestHandler(
+		std::move(stream), max_header_length, max_headers_count, std::move(server_version),
+		logger, std::move(environment)
+	)
+{
+	if (!coroutine_function)
+	{
+		throw NullPointerException("'coroutine_function' is nullptr", _ERROR_DETAILS_);
+	}
+
+	this->coroutine_function = std::move(coroutine_function);
+	this->async_stream = std::make_unique<AsyncStream>(this->stream.get());
+}
+#endif
+
 void BaseHTTPRequestHandler::handle()
 {
-	this->close_connection = true;
-	this->handle_one_request();
-	while (!this->close_connection)
+	do
 	{
+		this->close_connection = true;
 		this->handle_one_request();
+		this->wait_for_request();
 	}
+	while (this->finish_request());
+}
 
-	this->close_io();
+bool BaseHTTPRequestHandler::handle_next()
+{
+	this->close_connection = true;
+	this->handle_one_request();
+	return !this->is_suspended() && this->finish_request();
+}
+
+#if defined(__SERVER_HAS_COROUTINES__)
+bool BaseHTTPRequestHandler::resume(bool is_expired)
+{
+	this->resume_one_request(is_expired);
+	return !this->is_suspended() && this->finish_request();
+}
+#endif
+
+void BaseHTTPRequestHandler::set_timeouts(const StageTimeouts& timeouts)
+{
+	this->timeouts = timeouts;
+#if defined(__SERVER_HAS_COROUTINES__)
+	if (this->async_stream)
+	{
+		this->async_stream->set_timeouts(timeouts.body_read, timeouts.write);
+	}
+#endif
 }
 
 std::string BaseHTTPRequestHandler::default_error_message(
@@ -85,17 +174,26 @@ void BaseHTTPRequestHandler::cleanup_headers()
 	// HTTP/1.1 requires support for persistent connections. Send 'close' if
 	// the content length is unknown to prevent clients from reusing the
 	// connection.
-	if (!this->request_context.headers.contains("Content-Length"))
+	const auto& request = this->head_parser.request();
+	auto& headers = this->request_context.header_table;
+	auto connection_is_set = headers.contains(KnownHeader::Connection);
+
+	// Chunked bodies end by their framing.
+	auto has_length = request.content_length || request.transfer_encoding_chunked;
+
+	// The field of the client is kept, so the table and the map agree.
+	if (!has_length && !connection_is_set)
 	{
-		this->request_context.headers.insert(std::make_pair("Connection", "close"));
+		headers.add("Connection", "close", KnownHeader::Connection);
+		if (this->copy_headers)
+		{
+			this->request_context.headers.insert(std::make_pair("Connection", "close"));
+		}
 	}
 
 	// Mark the connection for closing if it's set as such above or if the
 	// application sent the header.
-	if (
-		this->request_context.headers.contains("Connection") &&
-		str::to_lower(this->request_context.headers.at("Connection")) == "close"
-	)
+	if (request.connection_close || (!connection_is_set && !has_length))
 	{
 		this->close_connection = true;
 	}
@@ -104,54 +202,30 @@ void BaseHTTPRequestHandler::cleanup_headers()
 bool BaseHTTPRequestHandler::parse_request()
 {
 	this->request_version = this->default_request_version;
-	auto http_version = this->default_request_version;
 	this->close_connection = true;
-	auto request_line = str::rtrim(
-		encoding::encode_iso_8859_1(this->raw_request_line, encoding::Mode::Strict), "\r\n"
-	);
-	std::string request_path;
-
-	// command, path, version
-	auto request_line_parts = str::split(request_line);
-	if (request_line_parts.size() == 3)
+	switch (this->head_parser.error())
 	{
-		this->request_context.method = request_line_parts[0];
-		request_path = request_line_parts[1];
-		http_version = request_line_parts[2];
-		if (!http_version.starts_with("HTTP/"))
-		{
-			this->send_error(400, "Bad request version (" + http_version + ")");
+		case ParseErrorKind::RequestLineTooLong:
+			// Request-URI Too Long.
+			this->send_error(414);
 			return false;
-		}
-
-		auto base_version_number = str::split(http_version, '/')[1];
-		auto version_number = str::split(base_version_number, '.');
-
-		// RFC 2145 section 3.1 says there can be only one "." and
-		//   - major and minor numbers MUST be treated as
-		//      separate integers;
-		//   - HTTP/2.4 is a lower version than HTTP/2.13, which in
-		//      turn is lower than HTTP/12.3;
-		//   - Leading zeros MUST be ignored by recipients.
-		if (version_number.size() != 2)
-		{
-			this->send_error(400, "Bad request version (" + http_version + ")");
+		case ParseErrorKind::BadRequestLine:
+			this->send_error(400, this->head_parser.error_message());
 			return false;
-		}
-
-		const char* major_version_string = version_number[0].c_str();
-		const char* minor_version_string = version_number[1].c_str();
+		default:
+			break;
+	}
 
+	const auto& request = this->head_parser.request();
+	this->request_context.method = request.method.in(this->raw_head);
+	std::string http_version = this->default_request_version;
+	if (!request.version.empty())
+	{
+		http_version = request.version.in(this->raw_head);
 		this->request_context.protocol_version = {
-			.major = (unsigned short)std::stoul(major_version_string, nullptr, 10),
-			.minor = (unsigned short)std::stoul(minor_version_string, nullptr, 10)
+			.major = request.major_version,
+			.minor = request.minor_version
 		};
-		if (!major_version_string || !minor_version_string)
-		{
-			this->send_error(400, "Bad request version (" + http_version + ")");
-			return false;
-		}
-
 		if (
 			this->request_context.protocol_version >= net::ProtocolVersion{1, 1} &&
 			this->protocol_version >= "HTTP/1.1"
@@ -163,32 +237,17 @@ bool BaseHTTPRequestHandler::parse_request()
 		if (this->request_context.protocol_version >= net::ProtocolVersion{2, 0})
 		{
 			// HTTP Version Not Supported.
-			this->send_error(505, "Invalid HTTP version (" + base_version_number + ")");
+			this->send_error(505, "Invalid HTTP version (" + http_version.substr(5) + ")");
 			return false;
 		}
 	}
-	else if (request_line_parts.size() == 2)
+	else if (this->request_context.method != "GET")
 	{
-		this->request_context.method = request_line_parts[0];
-		request_path = request_line_parts[1];
-		this->close_connection = true;
-		if (this->request_context.method != "GET")
-		{
-			this->send_error(400, "Bad HTTP/0.9 request type (" + this->request_context.method + ")");
-			return false;
-		}
-	}
-	else if (request_line_parts.empty())
-	{
-		return false;
-	}
-	else
-	{
-		this->send_error(400, "Bad request syntax (" + request_line + ")");
+		this->send_error(400, "Bad HTTP/0.9 request type (" + this->request_context.method + ")");
 		return false;
 	}
 
-	this->full_path = request_path;
+	this->full_path = request.target.in(this->raw_head);
 	this->request_version = http_version;
 
 	// Examine the headers and look for a Connection directive.
@@ -197,23 +256,19 @@ bool BaseHTTPRequestHandler::parse_request()
 		return false;
 	}
 
-	auto connection_type = this->request_context.headers.contains("Connection") ?
-		str::to_lower(this->request_context.headers.at("Connection")) : "";
-	if (connection_type == "close")
+	if (request.connection_close)
 	{
 		this->close_connection = true;
 	}
-	else if (connection_type == "keep-alive" && this->protocol_version >= "HTTP/1.1")
+	else if (request.connection_keep_alive && this->protocol_version >= "HTTP/1.1")
 	{
 		this->close_connection = false;
 		this->request_context.keep_alive = true;
 	}
 
 	// Examine the headers and look for expect directive.
-	auto expect = this->request_context.headers.contains("Expect") ?
-		str::to_lower(this->request_context.headers.at("Expect")) : "";
 	if (
-		expect == "100-continue" && this->protocol_version >= "HTTP/1.1" && this->request_version >= "HTTP/1.1"
+		request.expects_continue && this->protocol_version >= "HTTP/1.1" && this->request_version >= "HTTP/1.1"
 	)
 	{
 		if (!this->handle_expect_100())
@@ -237,39 +292,204 @@ bool BaseHTTPRequestHandler::handle_expect_100()
 
 void BaseHTTPRequestHandler::handle_one_request()
 {
-	if (!this->read_line(this->raw_request_line))
+	// The state of the previous request on the same connection, the
+	// header table keeps its memory.
+	static_cast<net::RequestContext&>(this->request_context) = {};
+	this->request_context.header_table.clear();
+	this->request_is_parsed = false;
+	this->start_stage(this->timeouts.idle, std::chrono::milliseconds::zero());
+	if (!this->read_head())
 	{
 		this->close_connection = true;
 		return;
 	}
 
-	if (this->raw_request_line.empty())
+	this->total_bytes_read_count += this->raw_head.size();
+	this->request_is_parsed = this->parse_request();
+	if (!this->request_is_parsed)
 	{
-		this->close_connection = true;
+		// An error code has been sent, just exit.
 		return;
 	}
-	else if (this->raw_request_line.size() > 65536)
+
+	this->cleanup_headers();
+	this->request_context.response_writer = this->stream;
+	this->request_context.body = this->body_stream();
+	if (this->socket_io)
 	{
-		// Request-URI Too Long.
-		this->send_error(414);
-		return;
+		// The next request follows the body, so it is looked for only if
+		// there is no body.
+		auto has_body = this->request_context.chunked || this->request_context.content_size > 0;
+		this->socket_io->set_pipelined(!has_body && this->has_received_request());
 	}
 
-	this->total_bytes_read_count += this->raw_request_line.size();
-	this->request_is_parsed = this->parse_request();
-	if (!this->request_is_parsed)
+	// The response of a synchronous handler is sent after the body is
+	// received, coroutines count the stages separately.
+	auto write_timeout = this->timeouts.write;
+	if (write_timeout != std::chrono::milliseconds::zero())
 	{
-		// An error code has been sent, just exit.
+		write_timeout += this->timeouts.body_read;
+	}
+
+	this->start_stage(this->timeouts.body_read, write_timeout);
+#if defined(__SERVER_HAS_COROUTINES__)
+	if (this->coroutine_function)
+	{
+		this->async_stream->begin_request(this->request_context.chunked ? this->chunked_body.get() : nullptr);
+		this->pending_request = this->coroutine_function(
+			&this->request_context, this->environment, this->async_stream.get()
+		);
+		this->pending_request.start();
+		this->complete_pending_request();
 		return;
 	}
+#endif
 
-	this->cleanup_headers();
-	this->request_context.response_writer = this->stream;
-	this->request_context.body = this->stream;
 	auto status_code = this->handler_function(&this->request_context, this->environment);
+	this->finish_body();
 	this->log_request(status_code, "");
 }
 
+void BaseHTTPRequestHandler::start_stage(
+	std::chrono::milliseconds read_timeout, std::chrono::milliseconds write_timeout
+)
+{
+	if (!this->socket_io)
+	{
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	auto deadline = [now](std::chrono::milliseconds timeout) {
+		return timeout == std::chrono::milliseconds::zero() ? std::chrono::steady_clock::time_point::max() : now + timeout;
+	};
+	this->socket_io->set_deadlines(deadline(read_timeout), deadline(write_timeout));
+}
+
+#if defined(__SERVER_HAS_COROUTINES__)
+void BaseHTTPRequestHandler::resume_one_request(bool is_expired)
+{
+	this->async_stream->resume(is_expired);
+	this->complete_pending_request();
+}
+#endif
+
+void BaseHTTPRequestHandler::wait_for_request()
+{
+#if defined(__SERVER_HAS_COROUTINES__)
+	while (this->is_suspended())
+	{
+		this->resume_one_request(!this->async_stream->wait());
+	}
+#endif
+}
+
+bool BaseHTTPRequestHandler::finish_request()
+{
+	if (this->close_connection)
+	{
+		// Queued data is sent by closing the writer.
+		this->close_io();
+		return false;
+	}
+
+	if (this->has_received_request())
+	{
+		// The response is sent together with the next ones.
+		return true;
+	}
+
+	if (this->socket_io)
+	{
+		try
+		{
+			this->socket_io->flush();
+		}
+		catch (const IOError& exc)
+		{
+			this->logger->error(exc);
+			this->close_io();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool BaseHTTPRequestHandler::has_received_request()
+{
+	return this->socket_io && this->socket_io->receive_request_head();
+}
+
+void BaseHTTPRequestHandler::complete_pending_request()
+{
+#if defined(__SERVER_HAS_COROUTINES__)
+	if (this->pending_request.is_valid() && this->pending_request.done())
+	{
+		// The coroutine is destroyed even if it failed.
+		auto request = std::move(this->pending_request);
+		this->finish_body();
+		this->log_request(request.result(), "");
+	}
+#endif
+}
+
+std::shared_ptr<io::ILimitedBufferedStream> BaseHTTPRequestHandler::body_stream()
+{
+	if (!this->request_context.chunked)
+	{
+		// Handlers can not read past the body, so the next request is
+		// left in the buffer.
+		this->stream->set_limit((ssize_t)this->request_context.content_size);
+		return this->stream;
+	}
+
+	if (this->chunked_body)
+	{
+		this->chunked_body->reset();
+	}
+	else
+	{
+		this->chunked_body = std::make_shared<ChunkedBodyReader>(
+			this->stream, this->max_header_length, this->max_headers_count, this->max_chunked_body_size
+		);
+	}
+
+	return this->chunked_body;
+}
+
+void BaseHTTPRequestHandler::finish_body()
+{
+	if (this->request_context.chunked)
+	{
+		if (!this->chunked_body->is_finished())
+		{
+			this->close_connection = true;
+		}
+
+		return;
+	}
+
+	// The rest of the body would be parsed as the next request, so it is
+	// skipped if it is already received, otherwise the connection is
+	// closed instead of waiting for it.
+	auto left_count = this->stream->limit();
+	if (left_count > 0)
+	{
+		std::string_view rest;
+		if (this->socket_io && this->socket_io->buffered() >= left_count)
+		{
+			this->socket_io->read(rest, left_count);
+		}
+		else
+		{
+			this->close_connection = true;
+		}
+	}
+
+	this->stream->set_limit(-1);
+}
+
 bool BaseHTTPRequestHandler::read_line(std::string& destination)
 {
 	try
@@ -289,61 +509,110 @@ bool BaseHTTPRequestHandler::read_line(std::string& destination)
 	return false;
 }
 
-bool BaseHTTPRequestHandler::write(const char* content, ssize_t count)
+bool BaseHTTPRequestHandler::read_head()
 {
+	this->raw_head = {};
+	if (!this->socket_io)
+	{
+		// Lines are parsed as they are read until the head is complete.
+		this->head_buffer.clear();
+		this->head_parser.reset();
+		auto status = ParseStatus::NeedMore;
+		std::string line;
+		while (status == ParseStatus::NeedMore)
+		{
+			if (!this->read_line(line))
+			{
+				return false;
+			}
+
+			if (line.empty())
+			{
+				break;
+			}
+
+			this->head_buffer += line;
+			status = this->head_parser.parse(this->head_buffer);
+		}
+
+		this->raw_head = this->head_buffer;
+		return status != ParseStatus::NeedMore;
+	}
+
 	try
 	{
-		this->stream->write(content, count);
+		// The connection may stay idle until the request begins.
+		if (!this->socket_io->wait_for_data())
+		{
+			return false;
+		}
+
+		this->start_stage(this->timeouts.header_read, std::chrono::milliseconds::zero());
+		return this->socket_io->read_head(this->raw_head, this->head_parser) != ParseStatus::NeedMore;
 	}
 	catch (const IOError& exc)
 	{
 		this->logger->error(exc);
-		return false;
+	}
+	catch (const EoF& exc)
+	{
+		this->logger->error(exc);
 	}
 
-	return true;
+	return false;
 }
 
-bool BaseHTTPRequestHandler::parse_headers()
+bool BaseHTTPRequestHandler::write(const char* content, ssize_t count)
 {
 	try
 	{
-		this->total_bytes_read_count += net::parse_headers(
-			this->request_context.headers, this->stream.get(), this->max_header_length, this->max_headers_count
-		);
-		return true;
-	}
-	catch (const LineTooLongError& exc)
-	{
-		// Request Header Fields Too Large.
-		this->send_error(
-			431, "Line too long",
-			"The server is unwilling to process the request because its header fields are too large"
-		);
-	}
-	catch (const TooMuchHeadersError& exc)
-	{
-		this->send_error(
-			431, "Too many headers",
-			"The server is unwilling to process the request because its header fields are too large"
-		);
+		this->stream->write(content, count);
 	}
 	catch (const IOError& exc)
 	{
-		this->close_connection = true;
+		this->logger->error(exc);
+		return false;
+	}
+
+	return true;
+}
+
+bool BaseHTTPRequestHandler::parse_headers()
+{
+	switch (this->head_parser.error())
+	{
+		case ParseErrorKind::HeaderLineTooLong:
+			// Request Header Fields Too Large.
+			this->send_error(
+				431, "Line too long",
+				"The server is unwilling to process the request because its header fields are too large"
+			);
+			return false;
+		case ParseErrorKind::TooManyHeaders:
+			this->send_error(
+				431, "Too many headers",
+				"The server is unwilling to process the request because its header fields are too large"
+			);
+			return false;
+		case ParseErrorKind::BadHeader:
+			this->send_error(400, this->head_parser.error_message());
+			return false;
+		default:
+			break;
 	}
-	catch (const ParseError& exc)
+
+	auto& headers = this->request_context.header_table;
+	for (const auto& header : this->head_parser.request().headers)
 	{
-		this->logger->error(exc);
-		this->close_connection = true;
+		headers.add(header.name.in(this->raw_head), header.value.in(this->raw_head), header.known);
 	}
-	catch (const EoF& exc)
+
+	if (this->copy_headers)
 	{
-		this->logger->error(exc);
-		this->close_connection = true;
+		headers.copy_to(this->request_context.headers);
 	}
 
-	return false;
+	return true;
 }
 
 void BaseHTTPRequestHandler::send_error(unsigned int code, const std::string& message, const std::string& explain)
@@ -417,14 +686,13 @@ void BaseHTTPRequestHandler::send_header(const std::string& keyword, const std::
 		);
 	}
 
-	if (str::to_lower(keyword) == "connection")
+	if (find_known_header(keyword) == KnownHeader::Connection)
 	{
-		auto value_lower = str::to_lower(value);
-		if (value_lower == "close")
+		if (equals_ignore_case(value, "close"))
 		{
 			this->close_connection = true;
 		}
-		else if (value_lower == "keep-alive")
+		else if (equals_ignore_case(value, "keep-alive"))
 		{
 			this->close_connection = false;
 		}
@@ -440,4 +708,18 @@ void BaseHTTPRequestHandler::end_headers()
 	}
 }
 
+void BaseHTTPRequestHandler::flush_headers()
+{
+	if (this->socket_io)
+	{
+		this->socket_io->queue(std::move(this->headers_buffer));
+	}
+	else
+	{
+		this->stream->write(this->headers_buffer.c_str(), (ssize_t)this->headers_buffer.size());
+	}
+
+	this->headers_buffer = "";
+}
+
 __SERVER_END__
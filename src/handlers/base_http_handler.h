@@ -29,6 +29,11 @@
 
 // Server libraries.
 #include "../interfaces.h"
+#include "../async_stream.h"
+#include "../chunked_body.h"
+#include "../header_table.h"
+#include "../request_parser.h"
+#include "../slab_pool.h"
 
 
 __SERVER_BEGIN__
@@ -37,6 +42,22 @@ using HandlerFunction = std::function<net::StatusCode(
 	net::RequestContext* /* context */, const std::map<std::string, std::string>& /* environment */
 )>;
 
+// Context of requests which are passed to handlers by this server.
+struct HTTPRequestContext : public net::RequestContext
+{
+	// Header fields which refer to the head of the request, valid
+	// while the request is handled.
+	HeaderTable header_table;
+};
+
+// Returns the header table of 'context' which should be passed to a
+// handler by this server.
+inline const HeaderTable& header_table(const net::RequestContext* context)
+{
+	require_non_null(context, "'context' is nullptr", _ERROR_DETAILS_);
+	return static_cast<const HTTPRequestContext*>(context)->header_table;
+}
+
 // TODO: docs for 'BaseHTTPRequestHandler'
 class BaseHTTPRequestHandler : public IRequestHandler
 {
@@ -47,35 +68,95 @@ public:
 		std::string server_version, xw::ILogger* logger,
 		std::map<std::string, std::string> environment,
 		HandlerFunction handler_function
-	) : logger(logger),
-	    stream(std::move(stream)),
-	    max_header_length(max_header_length),
-	    max_headers_count(max_headers_count),
-	    server_version_number(std::move(server_version)),
-	    close_connection(false),
-	    request_is_parsed(false),
-	    environment(std::move(environment)),
-	    total_bytes_read_count(0),
-		handler_function(std::move(handler_function))
+	);
+
+#if defined(__SERVER_HAS_COROUTINES__)
+	// Requests are handled by coroutines, which are suspended while the
+	// connection is not ready instead of blocking the thread.
+	BaseHTTPRequestHandler(
+		std::unique_ptr<io::ILimitedBufferedStream> stream,
+		size_t max_header_length, size_t max_headers_count,
+		std::string server_version, xw::ILogger* logger,
+		std::map<std::string, std::string> environment,
+		CoroutineHandlerFunction coroutine_function
+	);
+#endif
+
+	// Handlers are created for each connection. The size of derived
+	// handlers is passed through the virtual destructor.
+	static inline void* operator new(size_t size)
 	{
-		if (!this->handler_function)
-		{
-			throw NullPointerException("'handler_function' is nullptr", _ERROR_DETAILS_);
-		}
+		return SlabPool::allocate(size);
+	}
+
+	static inline void operator delete(void* pointer, size_t size) noexcept
+	{
+		SlabPool::deallocate(pointer, size);
 	}
 
 	// Handle multiple requests if necessary.
 	void handle() override;
 
+	// Handle a single request and close the stream if the connection
+	// should not be kept alive.
+	bool handle_next() override;
+
+#if defined(__SERVER_HAS_COROUTINES__)
+	[[nodiscard]]
+	inline bool is_suspended() const override
+	{
+		return this->pending_request.is_valid() && !this->pending_request.done();
+	}
+
+	[[nodiscard]]
+	inline AwaitedEvent awaited_event() const override
+	{
+		return this->async_stream ? this->async_stream->awaited_event() : AwaitedEvent{};
+	}
+
+	bool resume(bool is_expired) override;
+#endif
+
+	void set_timeouts(const StageTimeouts& timeouts) override;
+
+	// Header fields are copied to the map of the request context only if
+	// it is set, otherwise handlers use 'header_table'.
+	inline void set_copy_headers(bool copy_headers)
+	{
+		this->copy_headers = copy_headers;
+	}
+
+	// Limits bodies with chunked transfer coding, zero means no limit.
+	inline void set_max_chunked_body_size(size_t max_size)
+	{
+		this->max_chunked_body_size = max_size;
+	}
+
 protected:
 	xw::ILogger* logger;
 
 	HandlerFunction handler_function;
 
-	net::RequestContext request_context;
+#if defined(__SERVER_HAS_COROUTINES__)
+	CoroutineHandlerFunction coroutine_function;
+
+	// Created for coroutine handlers only.
+	std::unique_ptr<AsyncStream> async_stream;
+
+	// Coroutine of the current request which is not finished yet.
+	Coroutine<net::StatusCode> pending_request;
+#endif
+
+	HTTPRequestContext request_context;
 
 	std::shared_ptr<io::ILimitedBufferedStream> stream;
 
+	// Set if 'stream' is a socket, stage deadlines are not applied to
+	// other streams.
+	SocketIO* socket_io;
+
+	StageTimeouts timeouts;
+
 	// The server software number version.
 	std::string server_version_number;
 
@@ -91,7 +172,15 @@ protected:
 
 	bool close_connection;
 
-	std::string raw_request_line;
+	// Head of the current request, it refers to the buffer of the socket
+	// or to 'head_buffer' for other streams.
+	std::string_view raw_head;
+	std::string head_buffer;
+
+	// Holds positions of the parts of 'raw_head'. The socket swaps it
+	// with its own parser, which parses the head while it is received.
+	IncrementalRequestParser head_parser;
+
 	std::string request_version;
 	std::string command;
 	std::string full_path;
@@ -101,6 +190,13 @@ protected:
 
 	size_t total_bytes_read_count;
 
+	bool copy_headers = true;
+
+	size_t max_chunked_body_size = 0;
+
+	// Decodes chunked bodies of the connection, created by the first one.
+	std::shared_ptr<ChunkedBodyReader> chunked_body;
+
 	std::string headers_buffer;
 
 	bool request_is_parsed;
@@ -118,9 +214,9 @@ protected:
 
 	// Parse a request.
 	//
-	// The request should be stored in this->request_line; the results
-	// are in this->command, this->path, this->request_version and
-	// this->headers.
+	// The request head should be stored in this->raw_head; the results
+	// are in this->request_context, this->full_path and
+	// this->request_version.
 	//
 	// Return true for success, false for failure; on failure, an
 	// error is sent back.
@@ -139,9 +235,54 @@ protected:
 	// false.
 	virtual bool handle_expect_100();
 
-	// Handle a single HTTP request.
+	// Initializes the handler except the function which handles
+	// requests.
+	BaseHTTPRequestHandler(
+		std::unique_ptr<io::ILimitedBufferedStream> stream,
+		size_t max_header_length, size_t max_headers_count,
+		std::string server_version, xw::ILogger* logger,
+		std::map<std::string, std::string> environment
+	);
+
+	// Handle a single HTTP request. A coroutine handler may leave the
+	// request suspended.
 	void handle_one_request();
 
+	// Limit socket operations of the next stage of the request. Zero
+	// timeouts mean no limit.
+	void start_stage(std::chrono::milliseconds read_timeout, std::chrono::milliseconds write_timeout);
+
+#if defined(__SERVER_HAS_COROUTINES__)
+	// Continue the suspended request.
+	void resume_one_request(bool is_expired);
+#endif
+
+	// Block until the suspended request is finished, used when there is
+	// no event loop which resumes it.
+	void wait_for_request();
+
+	// Close the stream if the connection should not be kept alive.
+	// Returns true if it is kept. The response is not sent yet if the
+	// next request is already received, so responses to pipelined
+	// requests are sent together.
+	bool finish_request();
+
+	// True if the head of the next request is already received, e.g.
+	// if the client pipelines requests.
+	bool has_received_request();
+
+	// Log the result of the coroutine of the request if it is finished.
+	void complete_pending_request();
+
+	// Returns the stream of the body of the current request.
+	std::shared_ptr<io::ILimitedBufferedStream> body_stream();
+
+	// Removes the limit of the body after the handler. The connection is
+	// closed if the body is not read to the end and the rest of it is not
+	// received yet or is chunked, since it can not be skipped without
+	// decoding.
+	void finish_body();
+
 	// This sends an error response (so it must be called before any
 	// output has been generated), logs the error, and finally sends
 	// a piece of HTML explaining the error to the user.
@@ -163,11 +304,9 @@ protected:
 	// Send the blank line ending the MIME headers.
 	void end_headers();
 
-	inline void flush_headers()
-	{
-		this->stream->write(this->headers_buffer.c_str(), (ssize_t)this->headers_buffer.size());
-		this->headers_buffer = "";
-	}
+	// Sockets queue the headers, so they are sent together with the
+	// body by a single system call.
+	void flush_headers();
 
 	// Return the server software version string.
 	[[nodiscard]]
@@ -192,8 +331,13 @@ protected:
 
 	virtual bool read_line(std::string& destination);
 
+	// Read and parse the request head to this->raw_head. Sockets keep it
+	// in their buffer, other streams are read by lines.
+	virtual bool read_head();
+
 	virtual bool write(const char* content, ssize_t count);
 
+	// Collect parsed header lines of this->raw_head.
 	virtual bool parse_headers();
 
 	virtual inline void close_io() const
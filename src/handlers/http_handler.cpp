@@ -6,9 +6,6 @@
 
 #include "./http_handler.h"
 
-// Base libraries.
-#include <xalwart.base/string_utils.h>
-
 
 __SERVER_BEGIN__
 
@@ -20,53 +17,61 @@ bool HTTPRequestHandler::parse_request()
 		return false;
 	}
 
-	auto full_path_parts = str::split(this->full_path, '?', 1);
-	this->request_context.path = full_path_parts[0];
-	if (full_path_parts.size() == 2)
+	auto query_position = this->full_path.find('?');
+	this->request_context.path = this->full_path.substr(0, query_position);
+	if (query_position != std::string::npos)
 	{
-		this->request_context.query = full_path_parts[1];
+		this->request_context.query = this->full_path.substr(query_position + 1);
 	}
 
-	auto content_length = this->request_context.headers.contains("Content-Length") ?
-		this->request_context.headers.at("Content-Length") : "";
-	if (!content_length.empty())
+	const auto& request = this->head_parser.request();
+	if (request.has_transfer_encoding)
 	{
-		const char* content_length_string = content_length.c_str();
-		this->request_context.content_size = std::stoull(content_length_string, nullptr, 10);
-		if (!content_length_string)
+		// Any Transfer-Encoding overrides Content-Length. The body can not
+		// be framed unless chunked is the final coding, so the connection
+		// is closed, see RFC 7230, section 3.3.3.
+		if (request.transfer_encoding_malformed || !request.transfer_encoding_chunked)
 		{
-			this->send_error(400, "Bad request Content-Length header value (" + content_length + ")");
+			this->send_error(400, "Chunked is not the final Transfer-Encoding");
+			this->close_connection = true;
 			return false;
 		}
-
-		auto transfer_encoding = this->request_context.headers.contains("Transfer-Encoding") ?
-			this->request_context.headers.at("Transfer-Encoding") : "";
-		if (!transfer_encoding.empty() && str::to_lower(transfer_encoding).find("chunked") != std::string::npos)
+		else if (request.transfer_encoding_unsupported)
 		{
-			if (this->protocol_version < "HTTP/1.1")
-			{
-				this->send_error(
-					501, "Chunked Transfer-Encoding is not supported by " + this->protocol_version + " protocol"
-				);
-				this->close_connection = true;
-				return false;
-			}
-			else if (this->request_version < "HTTP/1.1")
-			{
-				this->send_error(400, "Chunked Transfer-Encoding is not supported by request");
-				this->close_connection = true;
-				return false;
-			}
-			else
-			{
-				this->request_context.chunked = true;
-
-				// TODO: read and parse chunked request.
-				this->send_error(400, "Chunked Transfer-Encoding is not supported by this server");
-				this->close_connection = true;
-				return false;
-			}
+			this->send_error(501, "Transfer-Encoding is not supported");
+			this->close_connection = true;
+			return false;
+		}
+		else if (this->protocol_version < "HTTP/1.1")
+		{
+			this->send_error(
+				501, "Chunked Transfer-Encoding is not supported by " + this->protocol_version + " protocol"
+			);
+			this->close_connection = true;
+			return false;
+		}
+		else if (this->request_version < "HTTP/1.1")
+		{
+			this->send_error(400, "Chunked Transfer-Encoding is not supported by request");
+			this->close_connection = true;
+			return false;
+		}
+		else if (request.content_length)
+		{
+			// Such requests may be used to smuggle another one through
+			// proxies, see RFC 7230, section 3.3.3.
+			this->send_error(400, "Both Content-Length and chunked Transfer-Encoding are set");
+			this->close_connection = true;
+			return false;
 		}
+
+		// The body is decoded while the handler reads it.
+		this->request_context.chunked = true;
+	}
+	else if (request.content_length)
+	{
+		// The value is validated by the parser.
+		this->request_context.content_size = *request.content_length;
 	}
 
 	return true;
@@ -44,10 +44,35 @@ public:
 		require_non_null(this->stream.get(), "'socket_stream' is nullptr", _ERROR_DETAILS_);
 	}
 
+#if defined(__SERVER_HAS_COROUTINES__)
+	inline explicit HTTPRequestHandler(
+		std::unique_ptr<io::ILimitedBufferedStream> stream,
+		const std::string& server_version,
+		size_t max_header_length, size_t max_headers_count,
+		xw::ILogger* logger, const std::map<std::string, std::string>& environment,
+		CoroutineHandlerFunction coroutine_function
+	) : BaseHTTPRequestHandler(
+			std::move(stream), max_header_length, max_headers_count, server_version,
+			logger, environment, std::move(coroutine_function)
+		)
+	{
+		require_non_null(this->stream.get(), "'socket_stream' is nullptr", _ERROR_DETAILS_);
+	}
+#endif
+
+	// Handles a single request and closes the connection. Pipelined
+	// requests which are received together with it are handled before
+	// closing, their responses are sent at once.
 	inline void handle() override
 	{
-		this->close_connection = true;
-		this->handle_one_request();
+		do
+		{
+			this->close_connection = true;
+			this->handle_one_request();
+			this->wait_for_request();
+		}
+		while (!this->close_connection && this->has_received_request());
+
 		this->close_io();
 	}
 
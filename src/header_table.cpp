@@ -0,0 +1,86 @@
+/**
+ * header_table.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./header_table.h"
+
+
+__SERVER_BEGIN__
+
+void HeaderTable::add(std::string_view name, std::string_view value, KnownHeader known)
+{
+	this->_fields.push_back(Field{.name = name, .value = value, .known = known});
+	auto& index = this->_known_fields[(size_t)known];
+	if (known != KnownHeader::Unknown && index == 0)
+	{
+		index = this->_fields.size();
+	}
+}
+
+void HeaderTable::clear()
+{
+	// Only indexes of added fields are set.
+	for (const auto& field : this->_fields)
+	{
+		this->_known_fields[(size_t)field.known] = 0;
+	}
+
+	this->_fields.clear();
+}
+
+const HeaderTable::Field* HeaderTable::find(std::string_view name) const
+{
+	auto known = find_known_header(name);
+	if (known != KnownHeader::Unknown)
+	{
+		return this->find(known);
+	}
+
+	for (const auto& field : this->_fields)
+	{
+		if (equals_ignore_case(field.name, name))
+		{
+			return &field;
+		}
+	}
+
+	return nullptr;
+}
+
+std::string HeaderTable::get_string(std::string_view name) const
+{
+	auto known = find_known_header(name);
+	std::string result;
+	bool is_found = false;
+	for (const auto& field : this->_fields)
+	{
+		if (known != KnownHeader::Unknown ? field.known == known : equals_ignore_case(field.name, name))
+		{
+			if (is_found)
+			{
+				result.append(", ");
+			}
+
+			result.append(field.value);
+			is_found = true;
+		}
+	}
+
+	return result;
+}
+
+void HeaderTable::copy_to(std::map<std::string, std::string>& headers) const
+{
+	for (const auto& field : this->_fields)
+	{
+		auto [position, is_inserted] = headers.try_emplace(std::string(field.name), field.value);
+		if (!is_inserted)
+		{
+			position->second.append(", ").append(field.value);
+		}
+	}
+}
+
+__SERVER_END__
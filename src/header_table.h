@@ -0,0 +1,128 @@
+/**
+ * header_table.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Header fields of a request which refer to its head.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <array>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Module definitions.
+#include "./_def_.h"
+
+// Server libraries.
+#include "./known_headers.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: HeaderTable
+// Flat list of header fields in the order of receiving. Names and values
+// are views of the request head, so nothing is copied while the table is
+// filled, and the memory of the list is kept for the next request of the
+// connection. Owning strings are created only if they are requested.
+//
+// Names are compared ignoring the case, see RFC 7230, section 3.2.
+// Repeated fields are kept as separate entries. The first field of each
+// well-known header is indexed, so it is found without scanning.
+class HeaderTable final
+{
+public:
+	struct Field
+	{
+		std::string_view name;
+		std::string_view value;
+		KnownHeader known;
+	};
+
+	[[nodiscard]]
+	inline size_t size() const
+	{
+		return this->_fields.size();
+	}
+
+	[[nodiscard]]
+	inline bool empty() const
+	{
+		return this->_fields.empty();
+	}
+
+	[[nodiscard]]
+	inline std::vector<Field>::const_iterator begin() const
+	{
+		return this->_fields.begin();
+	}
+
+	[[nodiscard]]
+	inline std::vector<Field>::const_iterator end() const
+	{
+		return this->_fields.end();
+	}
+
+	// 'name' and 'value' should stay valid while the table is used.
+	// 'known' should be the result of 'find_known_header' for 'name'.
+	void add(std::string_view name, std::string_view value, KnownHeader known);
+
+	inline void add(std::string_view name, std::string_view value)
+	{
+		this->add(name, value, find_known_header(name));
+	}
+
+	void clear();
+
+	// Returns the first field of 'header', nullptr if there is no such
+	// field.
+	[[nodiscard]]
+	inline const Field* find(KnownHeader header) const
+	{
+		auto index = this->_known_fields[(size_t)header];
+		return index == 0 ? nullptr : &this->_fields[index - 1];
+	}
+
+	// Returns the first field with 'name', nullptr if there is no such
+	// field.
+	[[nodiscard]]
+	const Field* find(std::string_view name) const;
+
+	template <typename NameT>
+	[[nodiscard]]
+	inline bool contains(const NameT& name) const
+	{
+		return this->find(name) != nullptr;
+	}
+
+	// Returns the value of the first field with 'name'.
+	template <typename NameT>
+	[[nodiscard]]
+	inline std::string_view get(const NameT& name, std::string_view default_value={}) const
+	{
+		auto* field = this->find(name);
+		return field ? field->value : default_value;
+	}
+
+	// Copies values of all fields with 'name' combined by ", ", see
+	// RFC 7230, section 3.2.2.
+	[[nodiscard]]
+	std::string get_string(std::string_view name) const;
+
+	// Copies fields to 'headers', values of repeated fields are combined
+	// as by 'get_string'.
+	void copy_to(std::map<std::string, std::string>& headers) const;
+
+private:
+	std::vector<Field> _fields;
+
+	// Index of the first field of each well-known header plus one, zero
+	// if there is no such field.
+	std::array<size_t, (size_t)KnownHeader::Count> _known_fields{};
+};
+
+__SERVER_END__
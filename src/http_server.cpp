@@ -6,31 +6,66 @@
 
 #include "./http_server.h"
 
+// C++ libraries.
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
 // Base libraries.
 #include <xalwart.base/net/meta.h>
 
 // Server libraries.
 #include "./utility.h"
 #include "./exceptions.h"
+#include "./uring.h"
 
 
 __SERVER_BEGIN__
 
+std::string Client::host() const
+{
+	char buffer[INET6_ADDRSTRLEN] = {0};
+	const void* address = nullptr;
+	switch (this->_address.ss_family)
+	{
+		case AF_INET:
+			address = &((const sockaddr_in*)&this->_address)->sin_addr;
+			break;
+		case AF_INET6:
+			address = &((const sockaddr_in6*)&this->_address)->sin6_addr;
+			break;
+		default:
+			return "";
+	}
+
+	if (this->_address_length == 0 || !::inet_ntop(this->_address.ss_family, address, buffer, sizeof(buffer)))
+	{
+		return "";
+	}
+
+	return buffer;
+}
+
 void DevelopmentHTTPServer::handle_event(AbstractWorker*, RequestTask& task)
 {
 	Measure measure;
 	measure.start();
 
-	auto socket_stream = this->context.create_stream(this->context, task.client.socket());
-	auto request_handler = this->context.create_request_handler(
-		this->context, std::move(socket_stream), this->environment
-	);
-	if (!request_handler)
 	{
-		throw NullPointerException("'request_handler' is nullptr", _ERROR_DETAILS_);
+		auto socket_stream = this->context.create_stream(this->context, task.client.socket());
+		auto request_handler = this->context.create_request_handler(
+			this->context, std::move(socket_stream), this->environment
+		);
+		if (!request_handler)
+		{
+			throw NullPointerException("'request_handler' is nullptr", _ERROR_DETAILS_);
+		}
+
+		request_handler->handle();
 	}
 
-	request_handler->handle();
+	// The stream may still use the socket until it is destroyed.
+	this->_close_client(task.client);
 
 	measure.end();
 	this->context.logger->debug("Time elapsed: " + std::to_string(measure.elapsed()) + " milliseconds");
@@ -45,15 +80,36 @@ void DevelopmentHTTPServer::event_function(AbstractWorker* worker, RequestTask&
 	catch (const ServerError& exc)
 	{
 		this->_shutdown_client(task.client);
+		this->_close_client(task.client);
 		this->context.logger->error(exc);
 	}
 	catch (const std::exception& exc)
 	{
 		this->_shutdown_client(task.client);
+		this->_close_client(task.client);
 		this->context.logger->error(exc.what(), _ERROR_DETAILS_);
 	}
 }
 
+void DevelopmentHTTPServer::batch_event_function(AbstractWorker* worker, RequestBatchTask& task)
+{
+	if (task.clients.empty())
+	{
+		return;
+	}
+
+	// Connections are spread between workers, so the accept loop pays
+	// for a single injection per batch and slow clients of the batch
+	// do not delay each other.
+	for (size_t i = 1; i < task.clients.size(); i++)
+	{
+		worker->inject_task<RequestTask>(task.clients[i]);
+	}
+
+	RequestTask first_task(task.clients.front());
+	this->event_function(worker, first_task);
+}
+
 DevelopmentHTTPServer::DevelopmentHTTPServer(Context context) : context(std::move(context))
 {
 	this->context.set_defaults();
@@ -63,14 +119,39 @@ DevelopmentHTTPServer::DevelopmentHTTPServer(Context context) : context(std::mov
 			this->event_function(std::forward<decltype(worker)>(worker), std::forward<decltype(task)>(task));
 		}
 	);
+	this->context.worker->add_task_listener<RequestBatchTask>(
+		[this](auto&& worker, auto&& task) {
+			this->batch_event_function(
+				std::forward<decltype(worker)>(worker), std::forward<decltype(task)>(task)
+			);
+		}
+	);
+#if defined(__linux__)
+	this->context.worker->add_task_listener<Reactor::ConnectionTask>(
+		[](auto&&, auto&& task) { task.reactor->process(task); }
+	);
+#endif
 }
 
 void DevelopmentHTTPServer::bind(const std::string& address, uint16_t port)
 {
-	this->_socket = util::create_server_socket(
-		address, port, this->context.socket_creation_retries_count, this->context.logger
-	);
-	this->_socket->set_options();
+	// Unix sockets can not share the address.
+	size_t acceptors_count = port == 0 ? 1 : this->context.acceptors_count;
+	if (acceptors_count == 0)
+	{
+		acceptors_count = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	this->_sockets.clear();
+	for (size_t i = 0; i < acceptors_count; i++)
+	{
+		auto socket = util::create_server_socket(
+			address, port, this->context.socket_creation_retries_count, this->context.logger
+		);
+		socket->set_options(this->context.socket_options);
+		this->_sockets.push_back(std::move(socket));
+	}
+
 	this->host = address;
 	this->server_port = port;
 	this->server_name = util::get_fully_qualified_domain_name(this->host);
@@ -79,31 +160,101 @@ void DevelopmentHTTPServer::bind(const std::string& address, uint16_t port)
 
 void DevelopmentHTTPServer::listen(const std::string& message)
 {
-	this->_socket->listen();
-	auto selector = this->context.create_selector(this->context, this->_socket->raw_socket());
-	selector->register_read_event();
+	for (const auto& socket : this->_sockets)
+	{
+		socket->listen();
+	}
+
+	this->_limiter = std::make_unique<ConnectionLimiter>(
+		this->context.connections_high_watermark, this->context.connections_low_watermark
+	);
+
+#if defined(__linux__)
+	if (this->context.steer_connections_by_cpu && this->_sockets.size() > 1)
+	{
+		try
+		{
+			util::attach_cpu_steering_program(this->_sockets.front()->raw_socket(), this->_sockets.size());
+		}
+		catch (const SocketError& exc)
+		{
+			this->context.logger->warning("Unable to steer connections by CPU: " + std::string(exc.what()));
+		}
+	}
+
+	if (this->context.use_reactor)
+	{
+		for (size_t i = 0; i < this->_sockets.size(); i++)
+		{
+			this->_reactors.push_back(
+				std::make_unique<Reactor>(
+					this->context, this->environment, this->_limiter.get(), this->context.worker.get()
+				)
+			);
+		}
+
+		// Connections are closed by workers, so listeners of reactors
+		// are enabled from their threads.
+		this->_limiter->set_resume_listener([this]() {
+			for (const auto& reactor : this->_reactors)
+			{
+				reactor->update_listeners();
+			}
+		});
+	}
+#endif
+
 	if (!message.empty())
 	{
 		this->context.logger->print(message);
 	}
 
-	while (this->_socket->is_open())
+	for (size_t i = 1; i < this->_sockets.size(); i++)
 	{
-		if (selector->select(this->context.timeout_seconds, this->context.timeout_microseconds))
-		{
-			auto client = this->_accept_client();
-			if (this->_socket->is_open() && client.is_valid())
+		this->_acceptor_threads.emplace_back([this, i]() {
+			try
 			{
-				this->context.worker->inject_task<RequestTask>(client);
+				this->_accept_connections(i);
 			}
-		}
+			catch (const ServerError& exc)
+			{
+				this->context.logger->error(exc);
+			}
+			catch (const std::exception& exc)
+			{
+				this->context.logger->error(exc.what(), _ERROR_DETAILS_);
+			}
+		});
 	}
+
+	this->_accept_connections(0);
 }
 
 void DevelopmentHTTPServer::close()
 {
 	this->context.worker->stop();
-	util::close_socket(this->_socket.get(), this->context.logger);
+#if defined(__linux__)
+	for (const auto& reactor : this->_reactors)
+	{
+		reactor->close();
+	}
+#endif
+
+	for (const auto& socket : this->_sockets)
+	{
+		util::close_socket(socket.get(), this->context.logger);
+	}
+
+	// Acceptors stop after the next timeout when sockets are closed.
+	for (auto& thread : this->_acceptor_threads)
+	{
+		if (thread.joinable() && thread.get_id() != std::this_thread::get_id())
+		{
+			thread.join();
+		}
+	}
+
+	this->_acceptor_threads.clear();
 }
 
 void DevelopmentHTTPServer::initialize_environment()
@@ -112,33 +263,304 @@ void DevelopmentHTTPServer::initialize_environment()
 	this->environment.insert(std::make_pair(net::meta::SERVER_PORT, std::to_string(this->server_port)));
 }
 
-Client DevelopmentHTTPServer::_accept_client() const
+Client DevelopmentHTTPServer::_accept_client(ISocket* socket) const
 {
-	auto client = Client{::accept(this->_socket->raw_socket(), nullptr, nullptr)};
-	if (!client.is_valid())
+	sockaddr_storage address{};
+	socklen_t address_length = sizeof(address);
+#if defined(__linux__)
+	auto client_socket = ::accept4(
+		socket->raw_socket(), (sockaddr*)&address, &address_length, SOCK_NONBLOCK | SOCK_CLOEXEC
+	);
+#else
+	auto client_socket = ::accept(socket->raw_socket(), (sockaddr*)&address, &address_length);
+	if (util::socket_is_valid(client_socket))
+	{
+		::fcntl(client_socket, F_SETFL, ::fcntl(client_socket, F_GETFL, 0) | O_NONBLOCK);
+		::fcntl(client_socket, F_SETFD, FD_CLOEXEC);
+	}
+#endif
+	if (!util::socket_is_valid(client_socket))
 	{
-		auto error_code = errno;
-		if (error_code == EBADF || error_code == EINVAL)
+		// The listener is closed by 'close' from another thread.
+		if (socket->is_open())
 		{
+			this->_handle_accept_error(socket->raw_socket(), errno);
+		}
+
+		return {};
+	}
+
+	if (!this->_limiter->try_acquire())
+	{
+		ConnectionLimiter::reject(client_socket);
+		return {};
+	}
+
+	return {client_socket, address, address_length};
+}
+
+void DevelopmentHTTPServer::_accept_clients(ISocket* socket, std::vector<Client>& clients) const
+{
+	clients.clear();
+	auto batch_size = std::max(this->context.accept_batch_size, (size_t)1);
+	while (clients.size() < batch_size && !this->_limiter->is_paused())
+	{
+		auto client = this->_accept_client(socket);
+		if (!client.is_valid())
+		{
+			break;
+		}
+
+		clients.push_back(client);
+	}
+}
+
+void DevelopmentHTTPServer::_inject_clients(std::vector<Client>& clients)
+{
+	if (clients.size() == 1)
+	{
+		this->context.worker->inject_task<RequestTask>(clients.front());
+	}
+	else if (!clients.empty())
+	{
+		this->context.worker->inject_task<RequestBatchTask>(std::move(clients));
+	}
+
+	clients.clear();
+}
+
+void DevelopmentHTTPServer::_handle_accept_error(Socket listener, int error_code) const
+{
+	switch (error_code)
+	{
+		// The backlog is drained or the connection is gone already.
+		case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+		case EWOULDBLOCK:
+#endif
+		case EINTR:
+		case ECONNABORTED:
+			return;
+		case EBADF:
+		case EINVAL:
 			throw SocketError(
 				error_code, "'accept' call failed: " + std::to_string(error_code), _ERROR_DETAILS_
 			);
+		// The pending connection keeps the listener readable, so it is
+		// rejected instead of waiting for free descriptors.
+		case EMFILE:
+		case ENFILE:
+			this->_limiter->reject_pending(listener);
+			return;
+		default:
+			throw SocketError(
+				error_code,
+				"'accept' call failed while accepting a new connection: " + std::to_string(error_code),
+				_ERROR_DETAILS_
+			);
+	}
+}
+
+int DevelopmentHTTPServer::_timeout_milliseconds() const
+{
+	return (int)(this->context.timeout_seconds * 1000 + this->context.timeout_microseconds / 1000);
+}
+
+void DevelopmentHTTPServer::_accept_connections(size_t index)
+{
+#if defined(__linux__)
+	if (this->context.steer_connections_by_cpu && this->_sockets.size() > 1)
+	{
+		util::pin_current_thread_to_cpu(index);
+	}
+#endif
+
+	auto* socket = this->_sockets[index].get();
+#if defined(__linux__)
+	if (this->context.use_reactor)
+	{
+		this->_listen_with_reactor(this->_reactors[index].get(), socket);
+		return;
+	}
+
+	if (this->context.io_backend == IOBackend::IOUring && this->_listen_with_ring(socket))
+	{
+		return;
+	}
+#endif
+
+	this->_listen_with_selector(socket);
+}
+
+void DevelopmentHTTPServer::_listen_with_selector(ISocket* socket)
+{
+	auto selector = this->context.create_selector(this->context, socket->raw_socket());
+	selector->register_read_event();
+	std::vector<Client> clients;
+	while (socket->is_open())
+	{
+		// Pending connections stay in the backlog while overloaded.
+		if (this->_limiter->is_paused())
+		{
+			this->_limiter->wait_for_resume(std::chrono::milliseconds(this->_timeout_milliseconds()));
+			continue;
 		}
 
-		if (error_code == EMFILE)
+		if (selector->select(this->context.timeout_seconds, this->context.timeout_microseconds))
 		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(300));
-			return client;
+			this->_accept_clients(socket, clients);
+			if (socket->is_open())
+			{
+				this->_inject_clients(clients);
+			}
+			else
+			{
+				for (const auto& client : clients)
+				{
+					this->_close_client(client);
+				}
+			}
 		}
+	}
+}
 
-		throw SocketError(
-			error_code, "'accept' call failed while accepting a new connection: " + std::to_string(error_code),
-			_ERROR_DETAILS_
+#if defined(__linux__)
+void DevelopmentHTTPServer::_listen_with_reactor(Reactor* reactor, ISocket* socket)
+{
+	reactor->add_listener(socket->raw_socket());
+	auto timeout_milliseconds = this->_timeout_milliseconds();
+	while (socket->is_open())
+	{
+		reactor->poll(timeout_milliseconds);
+	}
+}
+
+bool DevelopmentHTTPServer::_listen_with_ring(ISocket* socket)
+{
+	std::unique_ptr<IOUring> ring;
+	try
+	{
+		ring = std::make_unique<IOUring>(this->context.io_uring_entries, 0, 0);
+	}
+	catch (const SocketError& exc)
+	{
+		this->context.logger->warning(
+			"io_uring is unavailable, falling back to selectors: " + std::string(exc.what())
 		);
+		return false;
 	}
 
-	return client;
+	const uint64_t ACCEPT = 1, TIMEOUT = 2, CANCEL = 3;
+	auto listener = socket->raw_socket();
+
+	// Wakes up the loop periodically to check if the socket is closed.
+	__kernel_timespec timeout{
+		.tv_sec = this->context.timeout_seconds,
+		.tv_nsec = this->context.timeout_microseconds * 1000
+	};
+	bool is_multishot = true, is_accept_armed = false, is_timeout_armed = false, is_cancel_requested = false;
+	std::vector<Client> clients;
+	while (socket->is_open())
+	{
+		if (this->_limiter->is_paused())
+		{
+			// Multishot accept keeps taking connections until it is
+			// cancelled, pending connections should stay in the backlog.
+			if (!is_accept_armed)
+			{
+				this->_limiter->wait_for_resume(std::chrono::milliseconds(this->_timeout_milliseconds()));
+				continue;
+			}
+
+			if (!is_cancel_requested)
+			{
+				ring->prepare_cancel(ACCEPT, CANCEL);
+				is_cancel_requested = true;
+			}
+		}
+		else if (!is_accept_armed)
+		{
+			ring->prepare_accept(listener, is_multishot, ACCEPT);
+			is_accept_armed = true;
+		}
+
+		if (!is_timeout_armed)
+		{
+			ring->prepare_timeout(&timeout, TIMEOUT);
+			is_timeout_armed = true;
+		}
+
+		auto result = ring->submit(1);
+		if (result < 0)
+		{
+			throw SocketError(-result, "'io_uring_enter' call failed: " + std::to_string(-result), _ERROR_DETAILS_);
+		}
+
+		while (auto* cqe = ring->peek_cqe())
+		{
+			auto operation = cqe->user_data;
+			auto accept_result = cqe->res;
+			auto flags = cqe->flags;
+			ring->cqe_seen();
+			if (operation == TIMEOUT)
+			{
+				is_timeout_armed = false;
+				continue;
+			}
+
+			if (operation == CANCEL)
+			{
+				continue;
+			}
+
+			if (!(flags & IORING_CQE_F_MORE))
+			{
+				is_accept_armed = false;
+				is_cancel_requested = false;
+			}
+
+			if (accept_result >= 0)
+			{
+				if (!socket->is_open())
+				{
+					::close(accept_result);
+				}
+				else if (this->_limiter->try_acquire())
+				{
+					// Accept operations do not receive the address.
+					sockaddr_storage address{};
+					socklen_t address_length = sizeof(address);
+					if (::getpeername(accept_result, (sockaddr*)&address, &address_length) != 0)
+					{
+						address_length = 0;
+					}
+
+					clients.emplace_back(accept_result, address, address_length);
+				}
+				else
+				{
+					ConnectionLimiter::reject(accept_result);
+				}
+			}
+			else if (accept_result == -EINVAL && is_multishot)
+			{
+				// Multishot accept is supported since Linux 5.19.
+				is_multishot = false;
+			}
+			else if (accept_result != -ECANCELED)
+			{
+				this->_handle_accept_error(listener, -accept_result);
+			}
+		}
+
+		// Connections accepted by a single 'io_uring_enter' are passed
+		// to the worker at once.
+		this->_inject_clients(clients);
+	}
+
+	return true;
 }
+#endif
 
 void DevelopmentHTTPServer::_shutdown_client(Client client) const
 {
@@ -146,8 +568,12 @@ void DevelopmentHTTPServer::_shutdown_client(Client client) const
 	{
 		this->context.logger->error("'shutdown' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
 	}
+}
 
+void DevelopmentHTTPServer::_close_client(Client client) const
+{
 	::close(client.socket());
+	this->_limiter->release();
 }
 
 __SERVER_END__
@@ -13,6 +13,9 @@
 #include <functional>
 #include <memory>
 #include <map>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
 
 // Base libraries.
 #include <xalwart.base/interfaces/server.h>
@@ -24,6 +27,8 @@
 // Server libraries.
 #include "./interfaces.h"
 #include "./context.h"
+#include "./reactor.h"
+#include "./overload.h"
 
 
 __SERVER_BEGIN__
@@ -33,11 +38,16 @@ __SERVER_BEGIN__
 class Client final
 {
 public:
-	inline Client() : _socket(-1)
+	inline Client() : _socket(-1), _address{}, _address_length(0)
 	{
 	}
 
-	explicit inline Client(Socket socket) : _socket(socket)
+	explicit inline Client(Socket socket) : _socket(socket), _address{}, _address_length(0)
+	{
+	}
+
+	inline Client(Socket socket, const sockaddr_storage& address, socklen_t address_length) :
+		_socket(socket), _address(address), _address_length(address_length)
 	{
 	}
 
@@ -53,8 +63,27 @@ public:
 		return this->_socket;
 	}
 
+	// Address of the peer, 'address_length' is zero if it is unknown.
+	[[nodiscard]]
+	inline const sockaddr* address() const
+	{
+		return (const sockaddr*)&this->_address;
+	}
+
+	[[nodiscard]]
+	inline socklen_t address_length() const
+	{
+		return this->_address_length;
+	}
+
+	// Returns IP address of the peer or empty string if it is unknown.
+	[[nodiscard]]
+	std::string host() const;
+
 private:
 	Socket _socket;
+	sockaddr_storage _address;
+	socklen_t _address_length;
 };
 
 // TESTME: DevelopmentHTTPServer
@@ -98,19 +127,76 @@ struct RequestTask : public AbstractWorker::Task
 		}
 	};
 
+	// Clients accepted at once and injected with a single task.
+	struct RequestBatchTask : public AbstractWorker::Task
+	{
+		std::vector<Client> clients;
+
+		explicit inline RequestBatchTask(std::vector<Client> clients) : clients(std::move(clients))
+		{
+		}
+	};
+
 	void handle_event(AbstractWorker* worker, RequestTask& task);
 
 	void event_function(AbstractWorker* worker, RequestTask& task);
 
+	void batch_event_function(AbstractWorker* worker, RequestBatchTask& task);
+
 	void initialize_environment() override;
 
 private:
-	std::unique_ptr<ISocket> _socket;
+	// Listening sockets bound to the same address, each is served by
+	// its own acceptor thread. The first one is served by the thread
+	// which calls 'listen'.
+	std::vector<std::unique_ptr<ISocket>> _sockets;
+	std::vector<std::thread> _acceptor_threads;
+
+	// Shared by all acceptors, created by 'listen'.
+	std::unique_ptr<ConnectionLimiter> _limiter;
+
+#if defined(__linux__)
+	// Outlive 'listen', because workers may still process their
+	// connections.
+	std::vector<std::unique_ptr<Reactor>> _reactors;
+#endif
+
+	// Returns invalid client if there are no pending connections or
+	// the connection is rejected because of overload.
+	[[nodiscard]]
+	Client _accept_client(ISocket* socket) const;
+
+	// Drains up to 'Context::accept_batch_size' pending connections
+	// while accepting is not paused by the limiter.
+	void _accept_clients(ISocket* socket, std::vector<Client>& clients) const;
+
+	// Passes accepted clients to the worker with a single task.
+	void _inject_clients(std::vector<Client>& clients);
+
+	// Returns normally if the failed 'accept' call can be retried.
+	void _handle_accept_error(Socket listener, int error_code) const;
 
 	[[nodiscard]]
-	Client _accept_client() const;
+	int _timeout_milliseconds() const;
+
+	// Accept loop for the socket with 'index'.
+	void _accept_connections(size_t index);
+
+	void _listen_with_selector(ISocket* socket);
+
+#if defined(__linux__)
+	void _listen_with_reactor(Reactor* reactor, ISocket* socket);
+
+	// Accepts connections with multishot 'accept' operations, so a
+	// single system call can accept the whole backlog. Returns false if
+	// 'io_uring' is not available.
+	bool _listen_with_ring(ISocket* socket);
+#endif
 
 	void _shutdown_client(Client client) const;
+
+	// Closes the socket and unregisters the connection in the limiter.
+	void _close_client(Client client) const;
 };
 
 __SERVER_END__
@@ -8,18 +8,67 @@
 
 #pragma once
 
+// C++ libraries.
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
 // Module definitions.
 #include "./_def_.h"
 
 
 __SERVER_BEGIN__
 
+// Options of listening sockets and of accepted connections. Zero values
+// keep the defaults of the system. TCP options are ignored by Unix
+// sockets.
+struct SocketOptions
+{
+	// Listener: the length of the queue of pending connections, zero
+	// means 'SOMAXCONN'.
+	int backlog = 0;
+
+	// Listener, Linux only: connections are accepted when the first data
+	// arrives or after this count of seconds.
+	int defer_accept_seconds = 0;
+
+	// Listener: the length of the queue of pending TCP Fast Open
+	// requests, zero disables it.
+	int fast_open_queue_length = 0;
+
+	// Listener: sizes of socket buffers, inherited by accepted
+	// connections.
+	int receive_buffer_size = 0;
+	int send_buffer_size = 0;
+
+	// Connection: send small segments without waiting for ACKs of the
+	// previous ones, so Nagle's algorithm combined with delayed ACKs of
+	// the peer does not delay responses.
+	bool no_delay = true;
+
+	// Connection, Linux only: hold partial segments while a response is
+	// written, so the head and pieces of the body are sent as full
+	// segments. Released when the response is flushed.
+	bool cork_responses = false;
+
+	// Connection, Linux only: acknowledge received data immediately.
+	// The kernel resets it, so it is set again after each receive.
+	bool quick_ack = false;
+
+	// Connection: keep-alive probes after 'keep_alive_idle_seconds' of
+	// silence, zero disables them.
+	int keep_alive_idle_seconds = 0;
+	int keep_alive_interval_seconds = 0;
+	int keep_alive_probes_count = 0;
+};
+
 class ISocket
 {
 public:
 	virtual ~ISocket() = default;
 
-	virtual void set_options() = 0;
+	// Applies listener options and binds the socket.
+	virtual void set_options(const SocketOptions& options={}) = 0;
 
 	virtual void bind() = 0;
 
@@ -47,12 +96,141 @@ public:
 	virtual bool select(unsigned int timeout_seconds, unsigned int timeout_microseconds) = 0;
 };
 
+// Readiness notification for a single socket returned by
+// 'IPollingSelector::wait'.
+struct SelectorEvent
+{
+	enum Flags : uint32_t
+	{
+		None = 0,
+		Read = 1 << 0,
+		Write = 1 << 1,
+		HangUp = 1 << 2,
+		Error = 1 << 3,
+
+		// Registration only: disable the socket after one event is
+		// reported until it is re-armed with 'modify'.
+		OneShot = 1 << 4
+	};
+
+	Socket socket = -1;
+	uint32_t flags = None;
+
+	[[nodiscard]]
+	inline bool is_readable() const
+	{
+		return this->flags & Read;
+	}
+
+	[[nodiscard]]
+	inline bool is_writable() const
+	{
+		return this->flags & Write;
+	}
+
+	[[nodiscard]]
+	inline bool is_closed() const
+	{
+		return this->flags & (HangUp | Error);
+	}
+};
+
+enum class Trigger
+{
+	Level, Edge
+};
+
+// Extension of 'ISelector' which watches any number of sockets at
+// once and reports only those which are ready, so the cost of a single
+// wait does not depend on the count of registered sockets.
+class IPollingSelector : public ISelector
+{
+public:
+	// Start watching 'socket' for 'SelectorEvent::Flags' in 'events'.
+	virtual void add(Socket socket, uint32_t events, Trigger trigger) = 0;
+
+	// Replace the interest set of already registered 'socket'.
+	virtual void modify(Socket socket, uint32_t events, Trigger trigger) = 0;
+
+	virtual void remove(Socket socket) = 0;
+
+	// Block for up to 'timeout_milliseconds' (-1 means infinitely) and
+	// store ready sockets into 'events'. Returns the count of events.
+	virtual size_t wait(std::vector<SelectorEvent>& events, int timeout_milliseconds) = 0;
+};
+
+// Event which a suspended request handler waits for.
+struct AwaitedEvent
+{
+	// 'SelectorEvent' flags of the socket of the connection, none if
+	// the handler waits only for the deadline.
+	uint32_t flags = SelectorEvent::None;
+
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// Limits of stages of a connection. Unlike the timeout of a single
+// socket operation, a stage is not extended by each received chunk,
+// so a client which sends a byte at a time can not hold the
+// connection for the timeout times the count of reads. Zero disables
+// the limit of the stage.
+struct StageTimeouts
+{
+	// Waiting for the next request line of the connection.
+	std::chrono::milliseconds idle{0};
+
+	// Receiving the request head after the request line.
+	std::chrono::milliseconds header_read{0};
+
+	// Receiving the request body.
+	std::chrono::milliseconds body_read{0};
+
+	// Sending the response, counted after 'body_read' by synchronous
+	// handlers.
+	std::chrono::milliseconds write{0};
+};
+
 class IRequestHandler
 {
 public:
 	virtual ~IRequestHandler() = default;
 
 	virtual void handle() = 0;
+
+	// Handle a single request and leave the connection open if it can
+	// be reused. Returns false if the connection is closed. The body of
+	// the request should be read or skipped before the connection is
+	// left open, the next request is looked for right after it.
+	virtual inline bool handle_next()
+	{
+		this->handle();
+		return false;
+	}
+
+	// True if the last 'handle_next' or 'resume' call left the request
+	// unfinished because the handler waits for 'awaited_event'.
+	[[nodiscard]]
+	virtual inline bool is_suspended() const
+	{
+		return false;
+	}
+
+	[[nodiscard]]
+	virtual inline AwaitedEvent awaited_event() const
+	{
+		return {};
+	}
+
+	// Continue the suspended request when the awaited event occurs or
+	// its deadline expires. Returns the same as 'handle_next'.
+	virtual inline bool resume(bool is_expired)
+	{
+		return false;
+	}
+
+	virtual inline void set_timeouts(const StageTimeouts& timeouts)
+	{
+	}
 };
 
 __SERVER_END__
@@ -0,0 +1,356 @@
+/**
+ * known_headers.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Registry of well-known HTTP header names with a perfect hash which
+ * is generated at compile time.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Module definitions.
+#include "./_def_.h"
+
+
+__SERVER_BEGIN__
+
+// Compares ASCII strings ignoring the case of letters.
+constexpr bool equals_ignore_case(std::string_view left, std::string_view right)
+{
+	if (left.size() != right.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < left.size(); i++)
+	{
+		char l = left[i] >= 'A' && left[i] <= 'Z' ? (char)(left[i] + ('a' - 'A')) : left[i];
+		char r = right[i] >= 'A' && right[i] <= 'Z' ? (char)(right[i] + ('a' - 'A')) : right[i];
+		if (l != r)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Ordered as 'KNOWN_HEADER_NAMES'.
+enum class KnownHeader : uint8_t
+{
+	Unknown,
+	Accept,
+	AcceptCharset,
+	AcceptEncoding,
+	AcceptLanguage,
+	AcceptRanges,
+	AccessControlRequestHeaders,
+	AccessControlRequestMethod,
+	Age,
+	Allow,
+	Authorization,
+	CacheControl,
+	Connection,
+	ContentDisposition,
+	ContentEncoding,
+	ContentLanguage,
+	ContentLength,
+	ContentLocation,
+	ContentRange,
+	ContentType,
+	Cookie,
+	Date,
+	DNT,
+	ETag,
+	Expect,
+	Expires,
+	Forwarded,
+	From,
+	Host,
+	IfMatch,
+	IfModifiedSince,
+	IfNoneMatch,
+	IfRange,
+	IfUnmodifiedSince,
+	KeepAlive,
+	LastModified,
+	Location,
+	MaxForwards,
+	Origin,
+	Pragma,
+	ProxyAuthorization,
+	Range,
+	Referer,
+	RetryAfter,
+	SecFetchDest,
+	SecFetchMode,
+	SecFetchSite,
+	SecFetchUser,
+	Server,
+	SetCookie,
+	TE,
+	Trailer,
+	TransferEncoding,
+	Upgrade,
+	UpgradeInsecureRequests,
+	UserAgent,
+	Vary,
+	Via,
+	Warning,
+	WWWAuthenticate,
+	XForwardedFor,
+	XForwardedHost,
+	XForwardedProto,
+	XRealIP,
+	XRequestedWith,
+	Count
+};
+
+inline constexpr std::array<std::string_view, (size_t)KnownHeader::Count> KNOWN_HEADER_NAMES{
+	"",
+	"Accept",
+	"Accept-Charset",
+	"Accept-Encoding",
+	"Accept-Language",
+	"Accept-Ranges",
+	"Access-Control-Request-Headers",
+	"Access-Control-Request-Method",
+	"Age",
+	"Allow",
+	"Authorization",
+	"Cache-Control",
+	"Connection",
+	"Content-Disposition",
+	"Content-Encoding",
+	"Content-Language",
+	"Content-Length",
+	"Content-Location",
+	"Content-Range",
+	"Content-Type",
+	"Cookie",
+	"Date",
+	"DNT",
+	"ETag",
+	"Expect",
+	"Expires",
+	"Forwarded",
+	"From",
+	"Host",
+	"If-Match",
+	"If-Modified-Since",
+	"If-None-Match",
+	"If-Range",
+	"If-Unmodified-Since",
+	"Keep-Alive",
+	"Last-Modified",
+	"Location",
+	"Max-Forwards",
+	"Origin",
+	"Pragma",
+	"Proxy-Authorization",
+	"Range",
+	"Referer",
+	"Retry-After",
+	"Sec-Fetch-Dest",
+	"Sec-Fetch-Mode",
+	"Sec-Fetch-Site",
+	"Sec-Fetch-User",
+	"Server",
+	"Set-Cookie",
+	"TE",
+	"Trailer",
+	"Transfer-Encoding",
+	"Upgrade",
+	"Upgrade-Insecure-Requests",
+	"User-Agent",
+	"Vary",
+	"Via",
+	"Warning",
+	"WWW-Authenticate",
+	"X-Forwarded-For",
+	"X-Forwarded-Host",
+	"X-Forwarded-Proto",
+	"X-Real-IP",
+	"X-Requested-With"
+};
+
+namespace known_headers
+{
+
+inline constexpr size_t TABLE_BITS = 9;
+inline constexpr size_t TABLE_SIZE = (size_t)1 << TABLE_BITS;
+
+// Setting the 0x20 bit of each byte lowers ASCII letters and keeps '-'.
+// Known names consist of letters and '-', so other token characters,
+// which may be changed by it, never match them.
+inline constexpr uint64_t LOWER_CASE_BITS = 0x2020202020202020;
+
+// Loads 'Count' bytes, at most 8, as a little-endian word.
+template <size_t Count>
+constexpr uint64_t load(const char* data)
+{
+	if (!std::is_constant_evaluated() && std::endian::native == std::endian::little)
+	{
+		std::conditional_t<Count == 8, uint64_t, uint32_t> word;
+		static_assert(Count == sizeof(word));
+		std::memcpy(&word, data, Count);
+		return word;
+	}
+
+	uint64_t word = 0;
+	for (size_t i = 0; i < Count; i++)
+	{
+		word |= (uint64_t)(uint8_t)data[i] << (8 * i);
+	}
+
+	return word;
+}
+
+// Loads up to 3 bytes.
+constexpr uint64_t load_short(const char* data, size_t count)
+{
+	uint64_t word = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		word |= (uint64_t)(uint8_t)data[i] << (8 * i);
+	}
+
+	return word;
+}
+
+// Compares words of 'Count' bytes of 'name' and the known 'expected'
+// name of the same size, the last word may overlap the previous one.
+template <size_t Count>
+constexpr bool equals_by_words(const char* name, const char* expected, size_t size)
+{
+	for (size_t i = 0; i + Count < size; i += Count)
+	{
+		if ((load<Count>(name + i) | LOWER_CASE_BITS) != (load<Count>(expected + i) | LOWER_CASE_BITS))
+		{
+			return false;
+		}
+	}
+
+	auto last = size - Count;
+	return (load<Count>(name + last) | LOWER_CASE_BITS) == (load<Count>(expected + last) | LOWER_CASE_BITS);
+}
+
+// Combines the size with the first and the last words of the name in
+// lower case, which cover each known name except the longest ones.
+constexpr uint64_t key(std::string_view name)
+{
+	auto* data = name.data();
+	auto size = name.size();
+	uint64_t first, last;
+	if (size >= 8)
+	{
+		first = load<8>(data);
+		last = load<8>(data + size - 8);
+	}
+	else if (size >= 4)
+	{
+		first = load<4>(data);
+		last = load<4>(data + size - 4);
+	}
+	else
+	{
+		first = load_short(data, size);
+		last = 0;
+	}
+
+	return ((first | LOWER_CASE_BITS) ^ std::rotl(last | LOWER_CASE_BITS, 29)) + size;
+}
+
+constexpr size_t hash(std::string_view name, uint64_t seed)
+{
+	return (key(name) * seed) >> (64 - TABLE_BITS);
+}
+
+// Returns the first odd multiplier for which known names have no
+// collisions.
+consteval uint64_t find_seed()
+{
+	for (uint64_t seed = 0x9E3779B97F4A7C15; ; seed += 2)
+	{
+		std::array<bool, TABLE_SIZE> is_used{};
+		bool is_perfect = true;
+		for (size_t i = 1; i < KNOWN_HEADER_NAMES.size() && is_perfect; i++)
+		{
+			auto slot = hash(KNOWN_HEADER_NAMES[i], seed);
+			is_perfect = !is_used[slot];
+			is_used[slot] = true;
+		}
+
+		if (is_perfect)
+		{
+			return seed;
+		}
+	}
+}
+
+inline constexpr uint64_t SEED = find_seed();
+
+consteval std::array<KnownHeader, TABLE_SIZE> make_table()
+{
+	std::array<KnownHeader, TABLE_SIZE> table{};
+	for (size_t i = 1; i < KNOWN_HEADER_NAMES.size(); i++)
+	{
+		table[hash(KNOWN_HEADER_NAMES[i], SEED)] = (KnownHeader)i;
+	}
+
+	return table;
+}
+
+inline constexpr std::array<KnownHeader, TABLE_SIZE> TABLE = make_table();
+
+// Compares 'name' with the known 'expected' name of the same size.
+constexpr bool equals(std::string_view name, std::string_view expected)
+{
+	auto size = name.size();
+	if (size >= 8)
+	{
+		return equals_by_words<8>(name.data(), expected.data(), size);
+	}
+
+	if (size >= 4)
+	{
+		return equals_by_words<4>(name.data(), expected.data(), size);
+	}
+
+	return (load_short(name.data(), size) | LOWER_CASE_BITS) == (load_short(expected.data(), size) | LOWER_CASE_BITS);
+}
+
+}
+
+// TESTME: find_known_header
+// Returns the well-known header with 'name' ignoring the case or
+// 'KnownHeader::Unknown'. Takes a single hash of the size and the first
+// and last words of the name, and a comparison by words.
+constexpr KnownHeader find_known_header(std::string_view name)
+{
+	auto header = known_headers::TABLE[known_headers::hash(name, known_headers::SEED)];
+	auto expected = KNOWN_HEADER_NAMES[(size_t)header];
+	return expected.size() == name.size() && known_headers::equals(name, expected) ? header : KnownHeader::Unknown;
+}
+
+[[nodiscard]]
+constexpr std::string_view known_header_name(KnownHeader header)
+{
+	return KNOWN_HEADER_NAMES[(size_t)header];
+}
+
+static_assert(KNOWN_HEADER_NAMES.back() == "X-Requested-With", "names should be ordered as 'KnownHeader'");
+static_assert(find_known_header("content-length") == KnownHeader::ContentLength);
+static_assert(find_known_header("X-Custom") == KnownHeader::Unknown);
+
+__SERVER_END__
@@ -0,0 +1,186 @@
+/**
+ * overload.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./overload.h"
+
+// C++ libraries.
+#include <algorithm>
+#include <limits>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+__SERVER_BEGIN__
+
+// Sent as is, the client is not expected to reuse the connection.
+static const char SERVICE_UNAVAILABLE_RESPONSE[] = "HTTP/1.1 503 Service Unavailable\r\n"
+	"Connection: close\r\n"
+	"Content-Length: 0\r\n"
+	"Retry-After: 1\r\n"
+	"\r\n";
+
+static size_t get_descriptors_limit()
+{
+	rlimit limit{};
+	if (::getrlimit(RLIMIT_NOFILE, &limit) || limit.rlim_cur == RLIM_INFINITY)
+	{
+		return std::numeric_limits<int>::max();
+	}
+
+	return limit.rlim_cur;
+}
+
+static int open_spare_descriptor()
+{
+	return ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+ConnectionLimiter::ConnectionLimiter(size_t high_watermark, size_t low_watermark, size_t shares) :
+	_high_watermark(high_watermark),
+	_low_watermark(low_watermark),
+	_open_connections(0),
+	_is_paused(false)
+{
+	if (this->_high_watermark == 0)
+	{
+		auto limit = get_descriptors_limit();
+		this->_high_watermark = limit > 32 ? limit - std::max(limit / 8, (size_t)16) : std::max(limit / 2, (size_t)1);
+	}
+
+	shares = std::max(shares, (size_t)1);
+	this->_high_watermark = std::max(this->_high_watermark / shares, (size_t)1);
+	this->_low_watermark /= shares;
+
+	if (this->_low_watermark == 0 || this->_low_watermark > this->_high_watermark)
+	{
+		this->_low_watermark = this->_high_watermark - this->_high_watermark / 8;
+	}
+
+	this->_spare_descriptor = open_spare_descriptor();
+}
+
+ConnectionLimiter::~ConnectionLimiter()
+{
+	if (this->_spare_descriptor >= 0)
+	{
+		::close(this->_spare_descriptor);
+	}
+}
+
+bool ConnectionLimiter::try_acquire()
+{
+	std::lock_guard lock(this->_mutex);
+	if (this->_open_connections >= this->_high_watermark)
+	{
+		this->_is_paused = true;
+		return false;
+	}
+
+	this->_open_connections++;
+	if (this->_open_connections >= this->_high_watermark)
+	{
+		this->_is_paused = true;
+	}
+
+	return true;
+}
+
+void ConnectionLimiter::release()
+{
+	std::function<void()> resume_listener;
+	{
+		std::lock_guard lock(this->_mutex);
+		if (this->_open_connections > 0)
+		{
+			this->_open_connections--;
+		}
+
+		// A closed descriptor may be reused for the pending connection.
+		this->_exhausted_until = {};
+		if (!this->_is_paused || this->_open_connections > this->_low_watermark)
+		{
+			return;
+		}
+
+		this->_is_paused = false;
+		resume_listener = this->_resume_listener;
+	}
+
+	this->_resumed.notify_all();
+	if (resume_listener)
+	{
+		resume_listener();
+	}
+}
+
+bool ConnectionLimiter::is_paused() const
+{
+	std::lock_guard lock(this->_mutex);
+	return this->_is_paused_unlocked();
+}
+
+bool ConnectionLimiter::wait_for_resume(std::chrono::milliseconds timeout)
+{
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	std::unique_lock lock(this->_mutex);
+	while (this->_is_paused_unlocked())
+	{
+		// Exhaustion ends by itself, nobody notifies about it.
+		auto wakeup_time = this->_is_paused ? deadline : std::min(deadline, this->_exhausted_until);
+		if (this->_resumed.wait_until(lock, wakeup_time) == std::cv_status::timeout && wakeup_time == deadline)
+		{
+			return !this->_is_paused_unlocked();
+		}
+	}
+
+	return true;
+}
+
+void ConnectionLimiter::reject_pending(Socket listener)
+{
+	std::lock_guard lock(this->_mutex);
+	if (this->_spare_descriptor >= 0)
+	{
+		::close(this->_spare_descriptor);
+		this->_spare_descriptor = -1;
+		auto client = ::accept(listener, nullptr, nullptr);
+		auto error_code = errno;
+		if (client >= 0)
+		{
+			reject(client);
+		}
+
+		this->_spare_descriptor = open_spare_descriptor();
+		if (client >= 0 || (error_code != EMFILE && error_code != ENFILE))
+		{
+			return;
+		}
+	}
+
+	// Another thread took the spare descriptor, accepting is retried
+	// later instead of spinning on the readable listener.
+	this->_exhausted_until = std::chrono::steady_clock::now() + EXHAUSTION_BACKOFF;
+}
+
+void ConnectionLimiter::reject(Socket client)
+{
+	int flags = MSG_DONTWAIT;
+#if defined(MSG_NOSIGNAL)
+	flags |= MSG_NOSIGNAL;
+#endif
+	::send(client, SERVICE_UNAVAILABLE_RESPONSE, sizeof(SERVICE_UNAVAILABLE_RESPONSE) - 1, flags);
+	::shutdown(client, SHUT_WR);
+	::close(client);
+}
+
+bool ConnectionLimiter::_is_paused_unlocked() const
+{
+	return this->_is_paused || std::chrono::steady_clock::now() < this->_exhausted_until;
+}
+
+__SERVER_END__
@@ -0,0 +1,124 @@
+/**
+ * overload.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Accounting of open client connections and recovery from exhausted
+ * file descriptors.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+// Module definitions.
+#include "./_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: ConnectionLimiter
+// Counts open client connections of the server. When the count reaches
+// the high watermark accept loops stop taking new connections, so they
+// stay in the listen backlog, and continue when it drops to the low
+// watermark.
+//
+// A spare descriptor is kept open for the case when the process runs
+// out of descriptors anyway: it is released to accept the pending
+// connection and answer it with '503 Service Unavailable', otherwise
+// the connection would keep the listener readable forever.
+class ConnectionLimiter final
+{
+public:
+	// How long accept loops pause if descriptors are exhausted and the
+	// spare one is not available.
+	static constexpr auto EXHAUSTION_BACKOFF = std::chrono::milliseconds(100);
+
+	// Zero watermarks are derived from the 'RLIMIT_NOFILE' soft limit,
+	// leaving a part of descriptors for listeners, selectors, rings and
+	// the application itself. If connections are accounted by several
+	// independent limiters, each one gets 1/'shares' of watermarks.
+	ConnectionLimiter(size_t high_watermark, size_t low_watermark, size_t shares=1);
+
+	ConnectionLimiter(const ConnectionLimiter&) = delete;
+
+	ConnectionLimiter& operator= (const ConnectionLimiter&) = delete;
+
+	~ConnectionLimiter();
+
+	// Registers an accepted connection. Returns false if the high
+	// watermark is already reached, in this case the connection is not
+	// counted and should be rejected.
+	bool try_acquire();
+
+	// Unregisters a closed connection.
+	void release();
+
+	// Accept loops should not accept connections while it is true.
+	[[nodiscard]]
+	bool is_paused() const;
+
+	// Returns true if accepting is allowed before 'timeout' expires.
+	bool wait_for_resume(std::chrono::milliseconds timeout);
+
+	// Handles 'EMFILE' and 'ENFILE' errors of 'accept' on 'listener':
+	// the pending connection is accepted with the spare descriptor,
+	// answered with '503 Service Unavailable' and closed. If the spare
+	// descriptor is not available, accepting is paused for
+	// 'EXHAUSTION_BACKOFF'.
+	void reject_pending(Socket listener);
+
+	// Answers an accepted connection with '503 Service Unavailable' and
+	// closes it. Used for connections which exceed the high watermark.
+	static void reject(Socket client);
+
+	// Called without the lock held when accepting is allowed again.
+	inline void set_resume_listener(std::function<void()> listener)
+	{
+		std::lock_guard lock(this->_mutex);
+		this->_resume_listener = std::move(listener);
+	}
+
+	[[nodiscard]]
+	inline size_t open_connections() const
+	{
+		std::lock_guard lock(this->_mutex);
+		return this->_open_connections;
+	}
+
+	[[nodiscard]]
+	inline size_t high_watermark() const
+	{
+		return this->_high_watermark;
+	}
+
+	[[nodiscard]]
+	inline size_t low_watermark() const
+	{
+		return this->_low_watermark;
+	}
+
+private:
+	size_t _high_watermark;
+	size_t _low_watermark;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _resumed;
+	std::function<void()> _resume_listener;
+	size_t _open_connections;
+	bool _is_paused;
+	std::chrono::steady_clock::time_point _exhausted_until;
+
+	// Opened on '/dev/null', closed only for the time of
+	// 'reject_pending'.
+	int _spare_descriptor;
+
+	[[nodiscard]]
+	bool _is_paused_unlocked() const;
+};
+
+__SERVER_END__
@@ -0,0 +1,527 @@
+/**
+ * reactor.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./reactor.h"
+
+#if defined(__linux__)
+
+// C++ libraries.
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Server libraries.
+#include "./slab_pool.h"
+#include "./utility.h"
+#include "./exceptions.h"
+
+
+__SERVER_BEGIN__
+
+// Zero timeouts disable the timer of the stage.
+static std::chrono::steady_clock::time_point stage_deadline(std::chrono::milliseconds timeout)
+{
+	if (timeout == std::chrono::milliseconds::zero())
+	{
+		return std::chrono::steady_clock::time_point::max();
+	}
+
+	return std::chrono::steady_clock::now() + timeout;
+}
+
+Reactor::Reactor(
+	const Context& context,
+	std::map<std::string, std::string> environment,
+	ConnectionLimiter* limiter,
+	AbstractWorker* worker
+) :
+	context(context),
+	environment(std::move(environment)),
+	limiter(require_non_null(limiter, "'limiter' is nullptr", _ERROR_DETAILS_)),
+	worker(worker),
+	selector(context.logger),
+	is_listening(true),
+	wakeup_time(std::chrono::steady_clock::time_point::max())
+{
+	this->wakeup_descriptor = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (this->wakeup_descriptor < 0)
+	{
+		throw SocketError(errno, "'eventfd' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
+	}
+
+	this->selector.add(this->wakeup_descriptor, SelectorEvent::Read, Trigger::Level);
+}
+
+Reactor::~Reactor()
+{
+	::close(this->wakeup_descriptor);
+}
+
+void Reactor::add_listener(Socket listener)
+{
+	std::lock_guard lock(this->listeners_mutex);
+	this->selector.add(listener, this->is_listening ? SelectorEvent::Read : SelectorEvent::None, Trigger::Level);
+	this->listeners.push_back(listener);
+}
+
+void Reactor::poll(int timeout_milliseconds)
+{
+	if (!this->update_listeners())
+	{
+		// Exhaustion of descriptors ends without notification.
+		timeout_milliseconds = std::min(
+			timeout_milliseconds, (int)ConnectionLimiter::EXHAUSTION_BACKOFF.count()
+		);
+	}
+
+	auto timer_timeout = this->expire_timers();
+	if (timer_timeout >= 0 && (timeout_milliseconds < 0 || timer_timeout < timeout_milliseconds))
+	{
+		timeout_milliseconds = timer_timeout;
+	}
+
+	{
+		std::lock_guard lock(this->connections_mutex);
+		this->wakeup_time = timeout_milliseconds < 0 ? std::chrono::steady_clock::time_point::max() :
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_milliseconds);
+	}
+
+	this->selector.wait(this->events, timeout_milliseconds);
+	for (const auto& event : this->events)
+	{
+		if (event.socket == this->wakeup_descriptor)
+		{
+			eventfd_t value;
+			::eventfd_read(this->wakeup_descriptor, &value);
+			continue;
+		}
+
+		if (this->is_listener(event.socket))
+		{
+			this->accept_connections(event.socket);
+			continue;
+		}
+
+		auto connection = this->find_connection(event.socket);
+		if (!connection)
+		{
+			continue;
+		}
+
+		uint32_t awaited_flags;
+		{
+			std::lock_guard lock(this->connections_mutex);
+			if (connection->is_dispatched)
+			{
+				// Resumed by its deadline.
+				continue;
+			}
+
+			awaited_flags = connection->is_suspended ? connection->awaited_event.flags : SelectorEvent::None;
+		}
+
+		if (awaited_flags != SelectorEvent::None)
+		{
+			// Errors are reported by the socket to the handler.
+			this->dispatch(connection);
+		}
+		else if (event.is_readable())
+		{
+			this->read_request_head(connection);
+		}
+		else if (event.is_closed())
+		{
+			this->close_connection(connection);
+		}
+	}
+
+	this->expire_timers();
+}
+
+void Reactor::process(ConnectionTask& task)
+{
+	auto& connection = task.connection;
+	try
+	{
+		bool keep_alive = connection->is_suspended ?
+			connection->handler->resume(task.is_expired) : connection->handler->handle_next();
+
+		// Requests which are already received are handled at once. The
+		// handler skips the body of the previous one or closes the
+		// connection, so the body is not parsed as a request.
+		while (keep_alive && connection->stream->has_request_head())
+		{
+			keep_alive = connection->handler->handle_next();
+		}
+
+		if (connection->handler->is_suspended())
+		{
+			this->suspend(connection);
+			return;
+		}
+
+		if (keep_alive)
+		{
+			this->wait_for_next_request(connection);
+			return;
+		}
+	}
+	catch (const ServerError& exc)
+	{
+		this->context.logger->error(exc);
+	}
+	catch (const std::exception& exc)
+	{
+		this->context.logger->error(exc.what(), _ERROR_DETAILS_);
+	}
+
+	this->close_connection(connection);
+}
+
+void Reactor::close()
+{
+	std::vector<std::shared_ptr<Connection>> idle_connections;
+	{
+		std::lock_guard lock(this->connections_mutex);
+		for (const auto& [_, connection] : this->connections)
+		{
+			if (!connection->is_dispatched)
+			{
+				idle_connections.push_back(connection);
+			}
+		}
+	}
+
+	for (const auto& connection : idle_connections)
+	{
+		this->close_connection(connection);
+	}
+}
+
+bool Reactor::update_listeners()
+{
+	std::lock_guard lock(this->listeners_mutex);
+	bool should_listen = !this->limiter->is_paused();
+	if (should_listen == this->is_listening)
+	{
+		return should_listen;
+	}
+
+	for (auto listener : this->listeners)
+	{
+		this->selector.modify(listener, should_listen ? SelectorEvent::Read : SelectorEvent::None, Trigger::Level);
+	}
+
+	this->is_listening = should_listen;
+	return should_listen;
+}
+
+size_t Reactor::connections_count() const
+{
+	std::lock_guard lock(this->connections_mutex);
+	return this->connections.size();
+}
+
+void Reactor::accept_connections(Socket listener)
+{
+	// The listener is level-triggered, the rest of the backlog is
+	// accepted on the next iteration.
+	auto batch_size = std::max(this->context.accept_batch_size, (size_t)1);
+	for (size_t i = 0; i < batch_size && !this->limiter->is_paused(); i++)
+	{
+		auto socket = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (!util::socket_is_valid(socket))
+		{
+			auto error_code = errno;
+			switch (error_code)
+			{
+				case EAGAIN:
+					return;
+				case EINTR:
+				case ECONNABORTED:
+					continue;
+				case EMFILE:
+				case ENFILE:
+					this->limiter->reject_pending(listener);
+					return;
+				// The listener is closed by the server from another thread.
+				case EBADF:
+				case EINVAL:
+					return;
+				default:
+					throw SocketError(
+						error_code,
+						"'accept' call failed while accepting a new connection: " + std::to_string(error_code),
+						_ERROR_DETAILS_
+					);
+			}
+		}
+
+		if (!this->limiter->try_acquire())
+		{
+			ConnectionLimiter::reject(socket);
+			break;
+		}
+
+		try
+		{
+			this->add_connection(socket);
+		}
+		catch (const ServerError& exc)
+		{
+			this->context.logger->error(exc);
+			::close(socket);
+			this->limiter->release();
+		}
+	}
+}
+
+void Reactor::add_connection(Socket socket)
+{
+	timeval timeout{
+		.tv_sec = this->context.timeout_seconds,
+		.tv_usec = (int)this->context.timeout_microseconds
+	};
+	auto stream = std::make_unique<SocketIO>(
+		socket, timeout, this->context.create_selector(this->context, socket)
+	);
+	stream->set_options(this->context.socket_options);
+	stream->set_zero_copy_threshold(this->context.zero_copy_threshold);
+	stream->set_write_buffer_size(this->context.write_buffer_size);
+	auto* stream_pointer = stream.get();
+	auto connection = std::allocate_shared<Connection>(PoolAllocator<Connection>(), Connection{
+		.socket = socket,
+		.stream = stream_pointer,
+		.handler = this->context.create_request_handler(this->context, std::move(stream), this->environment),
+		.is_dispatched = false,
+		.is_suspended = false,
+		.is_receiving_head = true
+	});
+	require_non_null(connection->handler.get(), "'request_handler' is nullptr", _ERROR_DETAILS_);
+	connection->timer.data = connection.get();
+	{
+		std::lock_guard lock(this->connections_mutex);
+		this->connections[socket] = connection;
+
+		// The client is expected to send the request right after it
+		// is connected.
+		this->arm_timer(*connection, stage_deadline(this->context.stage_timeouts.header_read));
+	}
+
+	this->selector.add(socket, SelectorEvent::Read | SelectorEvent::OneShot, Trigger::Level);
+}
+
+void Reactor::read_request_head(const std::shared_ptr<Connection>& connection)
+{
+	try
+	{
+		if (!connection->stream->read_available())
+		{
+			this->close_connection(connection);
+			return;
+		}
+	}
+	catch (const SocketError& exc)
+	{
+		this->close_connection(connection);
+		return;
+	}
+
+	// Too long heads are passed to the handler, so it responds with
+	// the appropriate error.
+	if (
+		connection->stream->has_request_head() ||
+		connection->stream->buffered() >= (ssize_t)this->context.max_header_length
+	)
+	{
+		this->dispatch(connection);
+	}
+	else
+	{
+		this->wait_for_next_request(connection);
+	}
+}
+
+void Reactor::dispatch(const std::shared_ptr<Connection>& connection, bool is_expired)
+{
+	{
+		std::lock_guard lock(this->connections_mutex);
+		connection->is_dispatched = true;
+		connection->is_receiving_head = false;
+		this->arm_timer(*connection, std::chrono::steady_clock::time_point::max());
+	}
+
+	if (this->worker)
+	{
+		this->worker->inject_task<ConnectionTask>(this, connection, is_expired);
+	}
+	else
+	{
+		ConnectionTask task(this, connection, is_expired);
+		this->process(task);
+	}
+}
+
+void Reactor::wait_for_next_request(const std::shared_ptr<Connection>& connection)
+{
+	// Keep-alive connections may stay idle for long.
+	connection->stream->release_buffer();
+	{
+		std::lock_guard lock(this->connections_mutex);
+		connection->is_dispatched = false;
+		connection->is_suspended = false;
+
+		// The head deadline is not extended by each received part.
+		if (!connection->is_receiving_head && connection->stream->buffered() > 0)
+		{
+			connection->is_receiving_head = true;
+			this->arm_timer(*connection, stage_deadline(this->context.stage_timeouts.header_read));
+		}
+		else if (!connection->is_receiving_head)
+		{
+			this->arm_timer(*connection, stage_deadline(this->context.stage_timeouts.idle));
+		}
+	}
+
+	try
+	{
+		this->selector.modify(connection->socket, SelectorEvent::Read | SelectorEvent::OneShot, Trigger::Level);
+	}
+	catch (const SocketError& exc)
+	{
+		this->context.logger->error(exc);
+		this->close_connection(connection);
+	}
+}
+
+void Reactor::suspend(const std::shared_ptr<Connection>& connection)
+{
+	auto event = connection->handler->awaited_event();
+	{
+		std::lock_guard lock(this->connections_mutex);
+		connection->is_dispatched = false;
+		connection->is_suspended = true;
+		connection->awaited_event = event;
+		this->arm_timer(*connection, event.deadline);
+	}
+
+	try
+	{
+		// Without awaited flags only hang-ups and errors are reported.
+		this->selector.modify(connection->socket, event.flags | SelectorEvent::OneShot, Trigger::Level);
+	}
+	catch (const SocketError& exc)
+	{
+		this->context.logger->error(exc);
+		this->close_connection(connection);
+	}
+}
+
+void Reactor::arm_timer(Connection& connection, std::chrono::steady_clock::time_point deadline)
+{
+	if (deadline == std::chrono::steady_clock::time_point::max())
+	{
+		this->timers.cancel(&connection.timer);
+		return;
+	}
+
+	this->timers.arm(&connection.timer, deadline);
+
+	// Without a worker timers are armed by the thread which polls.
+	if (this->worker && deadline < this->wakeup_time)
+	{
+		this->wakeup_time = deadline;
+		::eventfd_write(this->wakeup_descriptor, 1);
+	}
+}
+
+int Reactor::expire_timers()
+{
+	std::vector<TimerWheel::Timer*> expired_timers;
+	std::vector<std::shared_ptr<Connection>> idle_connections, suspended_connections;
+	int timeout_milliseconds = -1;
+	{
+		std::lock_guard lock(this->connections_mutex);
+		auto now = std::chrono::steady_clock::now();
+		this->timers.advance(now, expired_timers);
+		for (auto* timer : expired_timers)
+		{
+			auto* connection = (Connection*)timer->data;
+			auto it = this->connections.find(connection->socket);
+			if (it == this->connections.end() || it->second.get() != connection || connection->is_dispatched)
+			{
+				continue;
+			}
+
+			if (connection->is_suspended)
+			{
+				suspended_connections.push_back(it->second);
+			}
+			else
+			{
+				idle_connections.push_back(it->second);
+			}
+		}
+
+		auto next_expiry = this->timers.next_expiry();
+		if (next_expiry != std::chrono::steady_clock::time_point::max())
+		{
+			timeout_milliseconds = (int)std::max(
+				std::chrono::ceil<std::chrono::milliseconds>(next_expiry - now).count(), (int64_t)0
+			);
+		}
+	}
+
+	for (const auto& connection : idle_connections)
+	{
+		this->close_connection(connection);
+	}
+
+	// The handler responds or closes the connection itself.
+	for (const auto& connection : suspended_connections)
+	{
+		this->dispatch(connection, true);
+	}
+
+	return suspended_connections.empty() ? timeout_milliseconds : 0;
+}
+
+void Reactor::close_connection(const std::shared_ptr<Connection>& connection)
+{
+	{
+		std::lock_guard lock(this->connections_mutex);
+		auto it = this->connections.find(connection->socket);
+		if (it == this->connections.end() || it->second != connection)
+		{
+			return;
+		}
+
+		this->connections.erase(it);
+		this->timers.cancel(&connection->timer);
+	}
+
+	// Closed descriptor is removed from the selector by the kernel.
+	::close(connection->socket);
+	this->limiter->release();
+}
+
+bool Reactor::is_listener(Socket socket)
+{
+	std::lock_guard lock(this->listeners_mutex);
+	return std::find(this->listeners.begin(), this->listeners.end(), socket) != this->listeners.end();
+}
+
+std::shared_ptr<Reactor::Connection> Reactor::find_connection(Socket socket) const
+{
+	std::lock_guard lock(this->connections_mutex);
+	auto it = this->connections.find(socket);
+	return it != this->connections.end() ? it->second : nullptr;
+}
+
+__SERVER_END__
+
+#endif // __linux__
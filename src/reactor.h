@@ -0,0 +1,186 @@
+/**
+ * reactor.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Event loop which owns client connections while they are idle or
+ * receive request headers and passes only ready requests to workers.
+ */
+
+#pragma once
+
+#if defined(__linux__)
+
+// C++ libraries.
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Base libraries.
+#include <xalwart.base/workers/abstract_worker.h>
+
+// Module definitions.
+#include "./_def_.h"
+
+// Server libraries.
+#include "./interfaces.h"
+#include "./context.h"
+#include "./selectors.h"
+#include "./overload.h"
+#include "./timer_wheel.h"
+#include "./sockets/io.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: Reactor
+// Waits for readiness of all connections with a single 'EpollSelector'.
+// Request heads are read without blocking and a connection is handed
+// to the worker only when its request can be parsed without waiting.
+// After the response is sent the worker returns a kept-alive
+// connection to the reactor, so idle and slow clients occupy no worker
+// threads. Suspended coroutine handlers wait in the reactor as well
+// and are resumed by a worker when the awaited event occurs or its
+// deadline expires.
+//
+// Each connection waiting in the reactor has a single timer for its
+// stage: idle until the next request starts, then the whole request
+// head, or the event awaited by the handler.
+//
+// 'poll' should be called from a single thread, 'process' is called
+// from worker threads. Without a worker requests are processed by the
+// thread which calls 'poll', so a connection never leaves it.
+class Reactor final
+{
+public:
+	struct Connection
+	{
+		Socket socket;
+
+		// Owned by 'handler'.
+		SocketIO* stream;
+
+		std::unique_ptr<IRequestHandler> handler;
+
+		// The connection is processed by a worker.
+		bool is_dispatched;
+
+		// The request handler waits for 'awaited_event'.
+		bool is_suspended;
+		AwaitedEvent awaited_event;
+
+		// A part of the request head is received.
+		bool is_receiving_head;
+
+		// Deadline of the current stage, guarded by 'connections_mutex'.
+		TimerWheel::Timer timer;
+	};
+
+	struct ConnectionTask : public AbstractWorker::Task
+	{
+		Reactor* reactor;
+		std::shared_ptr<Connection> connection;
+
+		// The deadline of the suspended request is expired.
+		bool is_expired;
+
+		inline ConnectionTask(Reactor* reactor, std::shared_ptr<Connection> connection, bool is_expired=false) :
+			reactor(reactor), connection(std::move(connection)), is_expired(is_expired)
+		{
+		}
+	};
+
+	// 'context', 'limiter' and 'worker' should outlive the reactor.
+	// 'worker' can be nullptr.
+	Reactor(
+		const Context& context,
+		std::map<std::string, std::string> environment,
+		ConnectionLimiter* limiter,
+		AbstractWorker* worker
+	);
+
+	~Reactor();
+
+	// Start accepting connections from non-blocking 'listener'.
+	void add_listener(Socket listener);
+
+	// Wait for events for up to 'timeout_milliseconds' and process
+	// them.
+	void poll(int timeout_milliseconds);
+
+	// Handle ready requests of the connection, called by a worker.
+	void process(ConnectionTask& task);
+
+	// Close all connections which are not processed by workers.
+	void close();
+
+	// Enables or disables events of listeners according to the state of
+	// the limiter. Returns true if listeners are enabled. Can be called
+	// from any thread.
+	bool update_listeners();
+
+	[[nodiscard]]
+	size_t connections_count() const;
+
+protected:
+	const Context& context;
+	std::map<std::string, std::string> environment;
+	ConnectionLimiter* limiter;
+	AbstractWorker* worker;
+	EpollSelector selector;
+
+	std::mutex listeners_mutex;
+	std::vector<Socket> listeners;
+	bool is_listening;
+
+	std::vector<SelectorEvent> events;
+
+	// Interrupts waiting of 'poll' when a worker arms a timer which
+	// expires before it wakes up.
+	Socket wakeup_descriptor;
+
+	mutable std::mutex connections_mutex;
+	std::map<Socket, std::shared_ptr<Connection>> connections;
+	TimerWheel timers;
+
+	// When 'poll' stops waiting for events.
+	std::chrono::steady_clock::time_point wakeup_time;
+
+	void accept_connections(Socket listener);
+
+	void add_connection(Socket socket);
+
+	void read_request_head(const std::shared_ptr<Connection>& connection);
+
+	void dispatch(const std::shared_ptr<Connection>& connection, bool is_expired=false);
+
+	// Wait for the next request of a kept-alive connection.
+	void wait_for_next_request(const std::shared_ptr<Connection>& connection);
+
+	// Wait for the event awaited by the suspended request handler.
+	void suspend(const std::shared_ptr<Connection>& connection);
+
+	// Should be called with locked 'connections_mutex'. The maximum
+	// 'deadline' cancels the timer.
+	void arm_timer(Connection& connection, std::chrono::steady_clock::time_point deadline);
+
+	// Close idle connections and resume suspended ones with expired
+	// timers. Returns the time left until the next expiration in
+	// milliseconds or -1.
+	int expire_timers();
+
+	void close_connection(const std::shared_ptr<Connection>& connection);
+
+	[[nodiscard]]
+	bool is_listener(Socket socket);
+
+	[[nodiscard]]
+	std::shared_ptr<Connection> find_connection(Socket socket) const;
+};
+
+__SERVER_END__
+
+#endif // __linux__
@@ -0,0 +1,544 @@
+/**
+ * request_parser.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./request_parser.h"
+
+// C++ libraries.
+#include <charconv>
+#include <string>
+
+// Base libraries.
+#include <xalwart.base/exceptions.h>
+
+// Server libraries.
+#include "./exceptions.h"
+#include "./simd.h"
+
+
+__SERVER_BEGIN__
+
+static inline TextRange text_range(const char* data, const char* begin, const char* end)
+{
+	return {.offset = (uint32_t)(begin - data), .size = (uint32_t)(end - begin)};
+}
+
+// Returns the line from 'begin' without the line break for error
+// messages.
+static std::string line_at(const char* begin, const char* end)
+{
+	auto* line_end = util::find_byte(begin, end, '\n');
+	if (line_end != begin && line_end[-1] == '\r')
+	{
+		line_end--;
+	}
+
+	return {begin, line_end};
+}
+
+// Returns the position after the line break at 'position', the same
+// 'position' if there is no line break and nullptr if the data ends
+// before the line break is complete.
+static inline const char* skip_line_break(const char* position, const char* end)
+{
+	if (*position == '\n')
+	{
+		return position + 1;
+	}
+
+	if (*position == '\r')
+	{
+		if (position + 1 == end)
+		{
+			return nullptr;
+		}
+
+		if (position[1] == '\n')
+		{
+			return position + 2;
+		}
+	}
+
+	return position;
+}
+
+// Parses a decimal number which fits 'unsigned short'. Returns the
+// position after it, nullptr if there are no digits or it is too big.
+static const char* parse_version_number(const char* begin, const char* end, unsigned short& number)
+{
+	unsigned int value = 0;
+	auto* position = begin;
+	for (; position != end && *position >= '0' && *position <= '9'; position++)
+	{
+		value = value * 10 + (*position - '0');
+		if (value > 0xFFFF)
+		{
+			return nullptr;
+		}
+	}
+
+	number = (unsigned short)value;
+	return position == begin ? nullptr : position;
+}
+
+// Calls 'function' for each non-empty element of the comma-separated
+// 'list' without whitespaces around it, see RFC 7230, section 7.
+template <typename FunctionT>
+static void for_each_list_element(std::string_view list, FunctionT function)
+{
+	while (!list.empty())
+	{
+		auto separator = list.find(',');
+		auto element = list.substr(0, separator);
+		while (!element.empty() && (element.front() == ' ' || element.front() == '\t'))
+		{
+			element.remove_prefix(1);
+		}
+
+		while (!element.empty() && (element.back() == ' ' || element.back() == '\t'))
+		{
+			element.remove_suffix(1);
+		}
+
+		if (!element.empty())
+		{
+			function(element);
+		}
+
+		if (separator == std::string_view::npos)
+		{
+			break;
+		}
+
+		list.remove_prefix(separator + 1);
+	}
+}
+
+// Stores the value of a header which decides how the request is read.
+static void resolve_header(KnownHeader header, std::string_view value, ParsedRequest& request)
+{
+	switch (header)
+	{
+		case KnownHeader::Connection:
+			for_each_list_element(value, [&](std::string_view option) {
+				if (equals_ignore_case(option, "close"))
+				{
+					request.connection_close = true;
+				}
+				else if (equals_ignore_case(option, "keep-alive"))
+				{
+					request.connection_keep_alive = true;
+				}
+			});
+			break;
+		case KnownHeader::ContentLength:
+			// Repeated equal values are accepted, see RFC 7230, section
+			// 3.3.2.
+			for_each_list_element(value, [&](std::string_view length) {
+				size_t number;
+				auto* length_end = length.data() + length.size();
+				auto [position, error] = std::from_chars(length.data(), length_end, number);
+				if (
+					error != std::errc() || position != length_end ||
+					(request.content_length && *request.content_length != number)
+				)
+				{
+					throw ParseError(
+						"Bad request Content-Length header value (" + std::string(value) + ")", _ERROR_DETAILS_
+					);
+				}
+
+				request.content_length = number;
+			});
+			break;
+		case KnownHeader::Expect:
+			request.expects_continue = request.expects_continue || equals_ignore_case(value, "100-continue");
+			break;
+		case KnownHeader::TransferEncoding:
+			// Codings of repeated fields continue the list of the previous
+			// ones, see RFC 7230, section 3.2.2.
+			request.has_transfer_encoding = true;
+			for_each_list_element(value, [&](std::string_view coding) {
+				// Transfer parameters follow the name of the coding.
+				coding = coding.substr(0, coding.find(';'));
+				while (!coding.empty() && (coding.back() == ' ' || coding.back() == '\t'))
+				{
+					coding.remove_suffix(1);
+				}
+
+				if (request.transfer_encoding_chunked)
+				{
+					request.transfer_encoding_malformed = true;
+				}
+
+				request.transfer_encoding_chunked = equals_ignore_case(coding, "chunked");
+				if (!request.transfer_encoding_chunked)
+				{
+					request.transfer_encoding_unsupported = true;
+				}
+			});
+			break;
+		default:
+			break;
+	}
+}
+
+size_t RequestParser::parse_request_line(std::string_view data, ParsedRequest& request) const
+{
+	auto* begin = data.data();
+	auto* end = begin + data.size();
+
+	// Empty lines before the request line are ignored, see RFC 7230,
+	// section 3.5.
+	auto* line_begin = begin;
+	while (line_begin != end && (*line_begin == '\r' || *line_begin == '\n'))
+	{
+		line_begin++;
+	}
+
+	auto incomplete = [&]() -> size_t
+	{
+		if ((size_t)(end - line_begin) > MAX_REQUEST_LINE_LENGTH)
+		{
+			throw LineTooLongError("request line", _ERROR_DETAILS_);
+		}
+
+		return 0;
+	};
+	auto bad_syntax = [&]()
+	{
+		return ParseError("Bad request syntax (" + line_at(line_begin, end) + ")", _ERROR_DETAILS_);
+	};
+
+	// Method and target are followed by a single space.
+	auto* method_end = util::find_non_token(line_begin, end);
+	if (method_end == end)
+	{
+		return incomplete();
+	}
+
+	if (method_end == line_begin || *method_end != ' ')
+	{
+		throw bad_syntax();
+	}
+
+	auto* target_begin = method_end + 1;
+	auto* target_end = util::find_control(target_begin, end, true);
+	if (target_end == end)
+	{
+		return incomplete();
+	}
+
+	if (target_end == target_begin)
+	{
+		throw bad_syntax();
+	}
+
+	request.method = text_range(begin, line_begin, method_end);
+	request.target = text_range(begin, target_begin, target_end);
+	const char* line_end;
+	if (*target_end == ' ')
+	{
+		auto* version_begin = target_end + 1;
+		auto* version_end = util::find_control(version_begin, end, true);
+		if (version_end == end)
+		{
+			return incomplete();
+		}
+
+		if (*version_end != '\r' && *version_end != '\n')
+		{
+			throw bad_syntax();
+		}
+
+		// RFC 2145 section 3.1 says there can be only one "." and
+		//   - major and minor numbers MUST be treated as
+		//      separate integers;
+		//   - HTTP/2.4 is a lower version than HTTP/2.13, which in
+		//      turn is lower than HTTP/12.3;
+		//   - Leading zeros MUST be ignored by recipients.
+		std::string_view version(version_begin, version_end - version_begin);
+		const char* position = nullptr;
+		if (version.starts_with("HTTP/"))
+		{
+			position = parse_version_number(version_begin + 5, version_end, request.major_version);
+			if (position && position != version_end && *position == '.')
+			{
+				position = parse_version_number(position + 1, version_end, request.minor_version);
+			}
+			else
+			{
+				position = nullptr;
+			}
+		}
+
+		if (position != version_end)
+		{
+			throw ParseError("Bad request version (" + std::string(version) + ")", _ERROR_DETAILS_);
+		}
+
+		request.version = text_range(begin, version_begin, version_end);
+		line_end = version_end;
+	}
+	else
+	{
+		// HTTP/0.9 request.
+		request.version = {};
+		request.major_version = 0;
+		request.minor_version = 9;
+		line_end = target_end;
+	}
+
+	auto* next_line = skip_line_break(line_end, end);
+	if (!next_line)
+	{
+		return incomplete();
+	}
+
+	if (next_line == line_end)
+	{
+		throw bad_syntax();
+	}
+
+	if ((size_t)(next_line - line_begin) > MAX_REQUEST_LINE_LENGTH)
+	{
+		throw LineTooLongError("request line", _ERROR_DETAILS_);
+	}
+
+	return next_line - begin;
+}
+
+size_t RequestParser::parse_header_line(
+	std::string_view data, size_t offset, ParsedRequest& request, bool& is_end
+) const
+{
+	auto* begin = data.data();
+	auto* end = begin + data.size();
+	auto* line_begin = begin + offset;
+	is_end = false;
+	if (line_begin == end)
+	{
+		return 0;
+	}
+
+	// The empty line ends the head.
+	if (*line_begin == '\r' || *line_begin == '\n')
+	{
+		auto* head_end = skip_line_break(line_begin, end);
+		if (!head_end)
+		{
+			return 0;
+		}
+
+		if (head_end == line_begin)
+		{
+			throw ParseError("Bad header line", _ERROR_DETAILS_);
+		}
+
+		is_end = true;
+		return head_end - line_begin;
+	}
+
+	if (request.headers.size() >= this->_max_headers_count)
+	{
+		throw TooMuchHeadersError(
+			"got more than " + std::to_string(this->_max_headers_count) + " headers", _ERROR_DETAILS_
+		);
+	}
+
+	// No whitespace is allowed before the colon, lines which start
+	// with whitespace continue obsolete folded values and are
+	// rejected as well, see RFC 7230, section 3.2.4.
+	auto* name_end = util::find_non_token(line_begin, end);
+	if (name_end == end)
+	{
+		return 0;
+	}
+
+	if (name_end == line_begin || *name_end != ':')
+	{
+		throw ParseError("Bad header line (" + line_at(line_begin, end) + ")", _ERROR_DETAILS_);
+	}
+
+	auto* value_begin = name_end + 1;
+	while (value_begin != end && (*value_begin == ' ' || *value_begin == '\t'))
+	{
+		value_begin++;
+	}
+
+	// Tabs are the only control characters allowed in values.
+	auto* value_end = util::find_control(value_begin, end, false);
+	while (value_end != end && *value_end == '\t')
+	{
+		value_end = util::find_control(value_end + 1, end, false);
+	}
+
+	if (value_end == end)
+	{
+		return 0;
+	}
+
+	auto* next_line = skip_line_break(value_end, end);
+	if (!next_line)
+	{
+		return 0;
+	}
+
+	if (next_line == value_end)
+	{
+		throw ParseError("Bad header line (" + line_at(line_begin, end) + ")", _ERROR_DETAILS_);
+	}
+
+	if ((size_t)(next_line - line_begin) > this->_max_line_length)
+	{
+		throw LineTooLongError("header line", _ERROR_DETAILS_);
+	}
+
+	while (value_end != value_begin && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+	{
+		value_end--;
+	}
+
+	auto known = find_known_header({line_begin, (size_t)(name_end - line_begin)});
+	request.headers.push_back(ParsedHeader{
+		.name = text_range(begin, line_begin, name_end),
+		.value = text_range(begin, value_begin, value_end),
+		.known = known
+	});
+	if (known != KnownHeader::Unknown)
+	{
+		resolve_header(known, {value_begin, (size_t)(value_end - value_begin)}, request);
+	}
+
+	return next_line - line_begin;
+}
+
+size_t RequestParser::parse_headers(std::string_view data, size_t offset, ParsedRequest& request) const
+{
+	auto position = offset;
+	auto headers_count = request.headers.size();
+	while (true)
+	{
+		bool is_end;
+		auto line_size = this->parse_header_line(data, position, request, is_end);
+		if (line_size == 0)
+		{
+			// The parsed headers are parsed again with more data, typed
+			// fields are set to the same values again.
+			request.headers.resize(headers_count);
+			if (data.size() - position > this->_max_line_length)
+			{
+				throw LineTooLongError("header line", _ERROR_DETAILS_);
+			}
+
+			return 0;
+		}
+
+		position += line_size;
+		if (is_end)
+		{
+			return position - offset;
+		}
+	}
+}
+
+ParseStatus IncrementalRequestParser::parse(std::string_view data)
+{
+	if (this->_status != ParseStatus::NeedMore)
+	{
+		return this->_status;
+	}
+
+	try
+	{
+		auto* begin = data.data();
+		auto* end = begin + data.size();
+		while (true)
+		{
+			// Lines are parsed only when they are complete, so the
+			// parsed data is not scanned again.
+			auto* line_end = util::find_byte(begin + this->_scan_offset, end, '\n');
+			if (line_end == end)
+			{
+				this->_scan_offset = data.size();
+				if (this->_is_request_line_parsed)
+				{
+					if (data.size() - this->_offset > this->_parser.max_line_length())
+					{
+						throw LineTooLongError("header line", _ERROR_DETAILS_);
+					}
+				}
+				else if (data.size() > RequestParser::MAX_REQUEST_LINE_LENGTH)
+				{
+					// Empty lines before the request line are limited too.
+					throw LineTooLongError("request line", _ERROR_DETAILS_);
+				}
+
+				return ParseStatus::NeedMore;
+			}
+
+			auto lines = data.substr(0, line_end + 1 - begin);
+			this->_scan_offset = lines.size();
+			if (!this->_is_request_line_parsed)
+			{
+				// Zero if there are only empty lines, which are skipped.
+				auto size = this->_parser.parse_request_line(lines, this->_request);
+				if (size == 0 && lines.size() > RequestParser::MAX_REQUEST_LINE_LENGTH)
+				{
+					throw LineTooLongError("request line", _ERROR_DETAILS_);
+				}
+
+				this->_offset = size == 0 ? lines.size() : size;
+				this->_is_request_line_parsed = size != 0;
+				continue;
+			}
+
+			bool is_end;
+			this->_offset += this->_parser.parse_header_line(lines, this->_offset, this->_request, is_end);
+			if (is_end)
+			{
+				this->_status = ParseStatus::Complete;
+				return this->_status;
+			}
+		}
+	}
+	catch (const LineTooLongError& exc)
+	{
+		this->_error = this->_is_request_line_parsed ? ParseErrorKind::HeaderLineTooLong : ParseErrorKind::RequestLineTooLong;
+		this->_error_message = exc.what();
+	}
+	catch (const TooMuchHeadersError& exc)
+	{
+		this->_error = ParseErrorKind::TooManyHeaders;
+		this->_error_message = exc.what();
+	}
+	catch (const ParseError& exc)
+	{
+		this->_error = this->_is_request_line_parsed ? ParseErrorKind::BadHeader : ParseErrorKind::BadRequestLine;
+		this->_error_message = exc.what();
+	}
+
+	this->_status = ParseStatus::Error;
+	return this->_status;
+}
+
+void IncrementalRequestParser::reset()
+{
+	if (this->_status == ParseStatus::NeedMore && this->_scan_offset == 0)
+	{
+		// Nothing is parsed.
+		return;
+	}
+
+	this->_request.clear();
+	this->_status = ParseStatus::NeedMore;
+	this->_is_request_line_parsed = false;
+	this->_offset = 0;
+	this->_scan_offset = 0;
+	this->_error = ParseErrorKind::None;
+	this->_error_message.clear();
+}
+
+__SERVER_END__
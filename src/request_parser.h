@@ -0,0 +1,270 @@
+/**
+ * request_parser.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Single-pass parser of HTTP/1.x request heads.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Module definitions.
+#include "./_def_.h"
+
+// Server libraries.
+#include "./known_headers.h"
+
+
+__SERVER_BEGIN__
+
+// Part of the parsed data, it stays valid while the data is not moved.
+struct TextRange
+{
+	uint32_t offset = 0;
+	uint32_t size = 0;
+
+	[[nodiscard]]
+	inline std::string_view in(std::string_view data) const
+	{
+		return data.substr(this->offset, this->size);
+	}
+
+	[[nodiscard]]
+	inline bool empty() const
+	{
+		return this->size == 0;
+	}
+};
+
+struct ParsedHeader
+{
+	TextRange name;
+
+	// Without leading and trailing whitespaces.
+	TextRange value;
+
+	KnownHeader known = KnownHeader::Unknown;
+};
+
+struct ParsedRequest
+{
+	TextRange method;
+	TextRange target;
+
+	// Empty for HTTP/0.9 requests which have no version.
+	TextRange version;
+	unsigned short major_version = 0;
+	unsigned short minor_version = 9;
+
+	std::vector<ParsedHeader> headers;
+
+	// Header fields which decide how the request is read, resolved
+	// while the headers are parsed.
+	std::optional<size_t> content_length;
+	bool connection_close = false;
+	bool connection_keep_alive = false;
+	bool expects_continue = false;
+
+	// 'Transfer-Encoding' is set, even without codings.
+	bool has_transfer_encoding = false;
+
+	// 'chunked' is the final transfer coding.
+	bool transfer_encoding_chunked = false;
+
+	// 'chunked' is followed by another coding, or is applied more than
+	// once, see RFC 7230, section 3.3.1.
+	bool transfer_encoding_malformed = false;
+
+	// A coding other than 'chunked' is applied, it is not supported.
+	bool transfer_encoding_unsupported = false;
+
+	// Keeps the memory of headers for the next request.
+	inline void clear()
+	{
+		this->method = {};
+		this->target = {};
+		this->version = {};
+		this->major_version = 0;
+		this->minor_version = 9;
+		this->headers.clear();
+		this->content_length.reset();
+		this->connection_close = false;
+		this->connection_keep_alive = false;
+		this->expects_continue = false;
+		this->has_transfer_encoding = false;
+		this->transfer_encoding_chunked = false;
+		this->transfer_encoding_malformed = false;
+		this->transfer_encoding_unsupported = false;
+	}
+};
+
+// TESTME: RequestParser
+// Parses the request line and the header lines of a request head in a
+// single pass, token and control characters are found by vectorized
+// scans. The result refers to the parsed data by offsets, nothing is
+// copied.
+//
+// Names of well-known headers are resolved by the perfect hash of
+// 'find_known_header', and values of 'Connection', 'Content-Length',
+// 'Expect' and 'Transfer-Encoding' are stored in typed fields.
+//
+// Methods return zero if the data ends before the parsed part, and
+// throw 'ParseError' if it is malformed, 'LineTooLongError' if a line
+// exceeds its limit and 'TooMuchHeadersError' if there are more
+// headers than allowed.
+class RequestParser final
+{
+public:
+	static constexpr size_t MAX_REQUEST_LINE_LENGTH = 65536;
+
+	// Defaults of 'Context'.
+	static constexpr size_t DEFAULT_MAX_LINE_LENGTH = 65535;
+	static constexpr size_t DEFAULT_MAX_HEADERS_COUNT = 100;
+
+	inline explicit RequestParser(size_t max_line_length, size_t max_headers_count) :
+		_max_line_length(max_line_length), _max_headers_count(max_headers_count)
+	{
+	}
+
+	// Parses the request line at the beginning of 'data', empty lines
+	// before it are skipped. Returns the count of parsed bytes.
+	size_t parse_request_line(std::string_view data, ParsedRequest& request) const;
+
+	// Parses a single header line at 'offset' or the empty line which
+	// ends the headers, then 'is_end' is set. Returns the count of parsed
+	// bytes.
+	size_t parse_header_line(std::string_view data, size_t offset, ParsedRequest& request, bool& is_end) const;
+
+	// Parses header lines from 'offset' up to and including the empty
+	// line which ends them. Returns the count of parsed bytes.
+	size_t parse_headers(std::string_view data, size_t offset, ParsedRequest& request) const;
+
+	// Parses the whole head. Returns its size.
+	inline size_t parse(std::string_view data, ParsedRequest& request) const
+	{
+		auto request_line_size = this->parse_request_line(data, request);
+		if (request_line_size == 0)
+		{
+			return 0;
+		}
+
+		auto headers_size = this->parse_headers(data, request_line_size, request);
+		return headers_size == 0 ? 0 : request_line_size + headers_size;
+	}
+
+	[[nodiscard]]
+	inline size_t max_line_length() const
+	{
+		return this->_max_line_length;
+	}
+
+private:
+	size_t _max_line_length;
+	size_t _max_headers_count;
+};
+
+enum class ParseStatus
+{
+	NeedMore,
+	Complete,
+	Error
+};
+
+enum class ParseErrorKind
+{
+	None,
+	BadRequestLine,
+	RequestLineTooLong,
+	BadHeader,
+	HeaderLineTooLong,
+	TooManyHeaders
+};
+
+// TESTME: IncrementalRequestParser
+// Parses a request head which is received in parts. 'parse' is called
+// with all data received for the head each time more of it arrives.
+// Complete lines are parsed once and the parser keeps the position
+// after them, so each call scans only the new bytes. The data may be
+// moved between calls, the result refers to it by offsets.
+//
+// Malformed data stops the parser with 'ParseStatus::Error', which is
+// described by 'error' and 'error_message'.
+class IncrementalRequestParser final
+{
+public:
+	inline explicit IncrementalRequestParser(
+		size_t max_line_length=RequestParser::DEFAULT_MAX_LINE_LENGTH,
+		size_t max_headers_count=RequestParser::DEFAULT_MAX_HEADERS_COUNT
+	) :
+		_parser(max_line_length, max_headers_count)
+	{
+	}
+
+	inline void set_limits(size_t max_line_length, size_t max_headers_count)
+	{
+		this->_parser = RequestParser(max_line_length, max_headers_count);
+	}
+
+	// Continues parsing of 'data', which should begin with the data of
+	// previous calls. Returns the status of the head, which stays the
+	// same after it is complete or malformed.
+	ParseStatus parse(std::string_view data);
+
+	// Prepares the parser for the next head. Keeps the memory of headers.
+	void reset();
+
+	[[nodiscard]]
+	inline ParseStatus status() const
+	{
+		return this->_status;
+	}
+
+	// Size of the complete head.
+	[[nodiscard]]
+	inline size_t head_size() const
+	{
+		return this->_status == ParseStatus::Complete ? this->_offset : 0;
+	}
+
+	[[nodiscard]]
+	inline const ParsedRequest& request() const
+	{
+		return this->_request;
+	}
+
+	[[nodiscard]]
+	inline ParseErrorKind error() const
+	{
+		return this->_error;
+	}
+
+	[[nodiscard]]
+	inline const std::string& error_message() const
+	{
+		return this->_error_message;
+	}
+
+private:
+	RequestParser _parser;
+	ParsedRequest _request;
+	ParseStatus _status = ParseStatus::NeedMore;
+	bool _is_request_line_parsed = false;
+
+	// Position of the first line which is not parsed.
+	size_t _offset = 0;
+
+	// Position up to which there is no line break after '_offset'.
+	size_t _scan_offset = 0;
+
+	ParseErrorKind _error = ParseErrorKind::None;
+	std::string _error_message;
+};
+
+__SERVER_END__
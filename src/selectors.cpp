@@ -9,6 +9,9 @@
 // C++ libraries.
 #include <cerrno>
 #include <cstring>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
 
 // Server libraries.
 #include "./utility.h"
@@ -67,4 +70,254 @@ bool Selector::select(uint timeout_seconds, uint timeout_microseconds)
 	return false;
 }
 
+#if defined(__linux__) || defined(__APPLE__)
+
+PollSelector::PollSelector(Socket socket, xw::ILogger* logger) : logger(logger)
+{
+	if (!this->logger)
+	{
+		throw NullPointerException("'logger' is nullptr", _ERROR_DETAILS_);
+	}
+
+	if (!util::socket_is_valid(socket))
+	{
+		throw ArgumentError("socket is invalid", _ERROR_DETAILS_);
+	}
+
+	this->descriptor.fd = socket;
+}
+
+void PollSelector::register_read_event()
+{
+	this->descriptor.events |= POLLIN;
+}
+
+void PollSelector::register_write_event()
+{
+	this->descriptor.events |= POLLOUT;
+}
+
+bool PollSelector::select(uint timeout_seconds, uint timeout_microseconds)
+{
+	int timeout_milliseconds = (int)(timeout_seconds * 1000 + (timeout_microseconds + 999) / 1000);
+	int poll_status = ::poll(&this->descriptor, 1, timeout_milliseconds);
+	if (poll_status < 0 && errno != EINTR)
+	{
+		this->logger->error("'poll' call failed: " + std::string(strerror(errno)), _ERROR_DETAILS_);
+	}
+
+	return poll_status > 0;
+}
+
+#endif // __linux__ || __APPLE__
+
+#if defined(__linux__)
+
+EpollSelector::EpollSelector(xw::ILogger* logger, size_t max_events) :
+	logger(logger), socket(-1), socket_events(SelectorEvent::None), socket_is_registered(false)
+{
+	if (!this->logger)
+	{
+		throw NullPointerException("'logger' is nullptr", _ERROR_DETAILS_);
+	}
+
+	if (max_events == 0)
+	{
+		throw ArgumentError("'max_events' should be greater than zero", _ERROR_DETAILS_);
+	}
+
+	this->epoll_descriptor = ::epoll_create1(EPOLL_CLOEXEC);
+	if (this->epoll_descriptor < 0)
+	{
+		auto error_code = errno;
+		throw SocketError(
+			error_code, "'epoll_create1' call failed: " + std::to_string(error_code), _ERROR_DETAILS_
+		);
+	}
+
+	this->ready_events.resize(max_events);
+}
+
+EpollSelector::EpollSelector(Socket socket, xw::ILogger* logger, size_t max_events) :
+	EpollSelector(logger, max_events)
+{
+	if (!util::socket_is_valid(socket))
+	{
+		::close(this->epoll_descriptor);
+		throw ArgumentError("socket is invalid", _ERROR_DETAILS_);
+	}
+
+	this->socket = socket;
+}
+
+EpollSelector::~EpollSelector()
+{
+	::close(this->epoll_descriptor);
+}
+
+void EpollSelector::register_read_event()
+{
+	this->register_event(SelectorEvent::Read);
+}
+
+void EpollSelector::register_write_event()
+{
+	this->register_event(SelectorEvent::Write);
+}
+
+bool EpollSelector::select(uint timeout_seconds, uint timeout_microseconds)
+{
+	int timeout_milliseconds = (int)(timeout_seconds * 1000 + (timeout_microseconds + 999) / 1000);
+	auto count = ::epoll_wait(
+		this->epoll_descriptor, this->ready_events.data(), (int)this->ready_events.size(), timeout_milliseconds
+	);
+	if (count < 0 && errno != EINTR)
+	{
+		this->logger->error("'epoll_wait' call failed: " + std::string(strerror(errno)), _ERROR_DETAILS_);
+	}
+
+	return count > 0;
+}
+
+void EpollSelector::add(Socket socket, uint32_t events, Trigger trigger)
+{
+	this->control(EPOLL_CTL_ADD, socket, events, trigger);
+}
+
+void EpollSelector::modify(Socket socket, uint32_t events, Trigger trigger)
+{
+	this->control(EPOLL_CTL_MOD, socket, events, trigger);
+}
+
+void EpollSelector::remove(Socket socket)
+{
+	// Closed descriptors are removed by the kernel automatically.
+	if (::epoll_ctl(this->epoll_descriptor, EPOLL_CTL_DEL, socket, nullptr) && errno != ENOENT && errno != EBADF)
+	{
+		auto error_code = errno;
+		throw SocketError(error_code, "'epoll_ctl' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+	}
+
+	if (socket == this->socket)
+	{
+		this->socket_is_registered = false;
+		this->socket_events = SelectorEvent::None;
+	}
+}
+
+size_t EpollSelector::wait(std::vector<SelectorEvent>& events, int timeout_milliseconds)
+{
+	events.clear();
+	auto count = ::epoll_wait(
+		this->epoll_descriptor, this->ready_events.data(), (int)this->ready_events.size(), timeout_milliseconds
+	);
+	if (count < 0)
+	{
+		auto error_code = errno;
+		if (error_code == EINTR)
+		{
+			return 0;
+		}
+
+		throw SocketError(error_code, "'epoll_wait' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+	}
+
+	events.reserve(count);
+	for (int i = 0; i < count; i++)
+	{
+		const auto& event = this->ready_events[i];
+		events.push_back(SelectorEvent{
+			.socket = event.data.fd,
+			.flags = from_epoll_events(event.events)
+		});
+	}
+
+	return (size_t)count;
+}
+
+void EpollSelector::control(int operation, Socket socket, uint32_t events, Trigger trigger)
+{
+	epoll_event event{};
+	event.events = to_epoll_events(events, trigger);
+	event.data.fd = socket;
+	if (::epoll_ctl(this->epoll_descriptor, operation, socket, &event))
+	{
+		auto error_code = errno;
+		throw SocketError(error_code, "'epoll_ctl' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+	}
+}
+
+void EpollSelector::register_event(uint32_t event)
+{
+	if (!util::socket_is_valid(this->socket))
+	{
+		throw ArgumentError("selector is not bound to a socket", _ERROR_DETAILS_);
+	}
+
+	this->socket_events |= event;
+	if (this->socket_is_registered)
+	{
+		this->modify(this->socket, this->socket_events, Trigger::Level);
+	}
+	else
+	{
+		this->add(this->socket, this->socket_events, Trigger::Level);
+		this->socket_is_registered = true;
+	}
+}
+
+uint32_t EpollSelector::to_epoll_events(uint32_t events, Trigger trigger)
+{
+	uint32_t result = EPOLLRDHUP;
+	if (events & SelectorEvent::Read)
+	{
+		result |= EPOLLIN;
+	}
+
+	if (events & SelectorEvent::Write)
+	{
+		result |= EPOLLOUT;
+	}
+
+	if (events & SelectorEvent::OneShot)
+	{
+		result |= EPOLLONESHOT;
+	}
+
+	if (trigger == Trigger::Edge)
+	{
+		result |= EPOLLET;
+	}
+
+	return result;
+}
+
+uint32_t EpollSelector::from_epoll_events(uint32_t events)
+{
+	uint32_t result = SelectorEvent::None;
+	if (events & EPOLLIN)
+	{
+		result |= SelectorEvent::Read;
+	}
+
+	if (events & EPOLLOUT)
+	{
+		result |= SelectorEvent::Write;
+	}
+
+	if (events & (EPOLLHUP | EPOLLRDHUP))
+	{
+		result |= SelectorEvent::HangUp;
+	}
+
+	if (events & EPOLLERR)
+	{
+		result |= SelectorEvent::Error;
+	}
+
+	return result;
+}
+
+#endif // __linux__
+
 __SERVER_END__
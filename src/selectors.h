@@ -9,8 +9,13 @@
 #pragma once
 
 // C++ libraries.
+#include <vector>
 #if defined(__linux__) || defined(__APPLE__)
 #include <sys/select.h>
+#include <poll.h>
+#endif
+#if defined(__linux__)
+#include <sys/epoll.h>
 #endif
 
 // Base libraries.
@@ -44,4 +49,94 @@ protected:
 	Socket socket;
 };
 
+#if defined(__linux__) || defined(__APPLE__)
+
+// Single socket selector based on 'poll' call. Unlike 'Selector' it is
+// not limited by 'FD_SETSIZE' and, unlike 'EpollSelector', requires no
+// kernel objects, so it is cheap to create per connection.
+class PollSelector : public ISelector
+{
+public:
+	explicit PollSelector(Socket socket, xw::ILogger* logger);
+
+	void register_read_event() override;
+
+	void register_write_event() override;
+
+	bool select(uint timeout_seconds, uint timeout_microseconds) override;
+
+protected:
+	xw::ILogger* logger;
+	pollfd descriptor{};
+};
+
+#endif // __linux__ || __APPLE__
+
+#if defined(__linux__)
+
+// Selector based on Linux 'epoll' facility. It is not limited by
+// 'FD_SETSIZE' and the cost of 'wait' is proportional to the count of
+// ready sockets only.
+//
+// When constructed with a socket, it is registered immediately, so the
+// instance can be used as a drop-in replacement of 'Selector'.
+class EpollSelector : public IPollingSelector
+{
+public:
+	explicit EpollSelector(xw::ILogger* logger, size_t max_events=DEFAULT_MAX_EVENTS);
+
+	explicit EpollSelector(Socket socket, xw::ILogger* logger, size_t max_events=1);
+
+	EpollSelector(const EpollSelector&) = delete;
+
+	EpollSelector& operator= (const EpollSelector&) = delete;
+
+	~EpollSelector() override;
+
+	void register_read_event() override;
+
+	void register_write_event() override;
+
+	bool select(uint timeout_seconds, uint timeout_microseconds) override;
+
+	void add(Socket socket, uint32_t events, Trigger trigger) override;
+
+	void modify(Socket socket, uint32_t events, Trigger trigger) override;
+
+	void remove(Socket socket) override;
+
+	size_t wait(std::vector<SelectorEvent>& events, int timeout_milliseconds) override;
+
+	[[nodiscard]]
+	inline int raw_descriptor() const
+	{
+		return this->epoll_descriptor;
+	}
+
+	static constexpr size_t DEFAULT_MAX_EVENTS = 1024;
+
+protected:
+	xw::ILogger* logger;
+	int epoll_descriptor;
+
+	// Socket passed to the constructor, used by 'ISelector' methods.
+	Socket socket;
+	uint32_t socket_events;
+	bool socket_is_registered;
+
+	std::vector<epoll_event> ready_events;
+
+	void control(int operation, Socket socket, uint32_t events, Trigger trigger);
+
+	void register_event(uint32_t event);
+
+	[[nodiscard]]
+	static uint32_t to_epoll_events(uint32_t events, Trigger trigger);
+
+	[[nodiscard]]
+	static uint32_t from_epoll_events(uint32_t events);
+};
+
+#endif // __linux__
+
 __SERVER_END__
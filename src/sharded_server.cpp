@@ -0,0 +1,178 @@
+/**
+ * sharded_server.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./sharded_server.h"
+
+#if defined(__linux__)
+
+// Base libraries.
+#include <xalwart.base/net/meta.h>
+
+// Server libraries.
+#include "./utility.h"
+#include "./exceptions.h"
+#include "./overload.h"
+#include "./reactor.h"
+
+
+__SERVER_BEGIN__
+
+ShardedHTTPServer::ShardedHTTPServer(Context context) : context(std::move(context))
+{
+	this->context.set_defaults();
+	this->context.validate(false);
+
+	// A synchronous handler blocks the event loop of its shard while it
+	// reads the body and writes the response, so a slow client would
+	// stall the whole shard. These stages are limited by the timeout of a
+	// single operation unless they are set.
+	bool is_synchronous = true;
+#if defined(__SERVER_HAS_COROUTINES__)
+	is_synchronous = !this->context.coroutine_handler;
+#endif
+	if (is_synchronous)
+	{
+		auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::seconds(this->context.timeout_seconds) +
+			std::chrono::microseconds(this->context.timeout_microseconds)
+		);
+		auto& timeouts = this->context.stage_timeouts;
+		if (timeouts.body_read == std::chrono::milliseconds::zero())
+		{
+			timeouts.body_read = timeout;
+		}
+
+		if (timeouts.write == std::chrono::milliseconds::zero())
+		{
+			timeouts.write = timeout;
+		}
+	}
+}
+
+void ShardedHTTPServer::bind(const std::string& address, uint16_t port)
+{
+	// Unix sockets can not share the address.
+	size_t shards_count = port == 0 ? 1 : this->context.acceptors_count;
+	if (shards_count == 0)
+	{
+		shards_count = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	this->_sockets.clear();
+	for (size_t i = 0; i < shards_count; i++)
+	{
+		auto socket = util::create_server_socket(
+			address, port, this->context.socket_creation_retries_count, this->context.logger
+		);
+		socket->set_options(this->context.socket_options);
+		this->_sockets.push_back(std::move(socket));
+	}
+
+	this->host = address;
+	this->server_port = port;
+	this->server_name = util::get_fully_qualified_domain_name(this->host);
+	this->initialize_environment();
+}
+
+void ShardedHTTPServer::listen(const std::string& message)
+{
+	for (const auto& socket : this->_sockets)
+	{
+		socket->listen();
+	}
+
+	if (this->context.steer_connections_by_cpu && this->_sockets.size() > 1)
+	{
+		try
+		{
+			util::attach_cpu_steering_program(this->_sockets.front()->raw_socket(), this->_sockets.size());
+		}
+		catch (const SocketError& exc)
+		{
+			this->context.logger->warning("Unable to steer connections by CPU: " + std::string(exc.what()));
+		}
+	}
+
+	if (!message.empty())
+	{
+		this->context.logger->print(message);
+	}
+
+	for (size_t i = 1; i < this->_sockets.size(); i++)
+	{
+		this->_shard_threads.emplace_back([this, i]() {
+			try
+			{
+				this->_run_shard(i);
+			}
+			catch (const ServerError& exc)
+			{
+				this->context.logger->error(exc);
+			}
+			catch (const std::exception& exc)
+			{
+				this->context.logger->error(exc.what(), _ERROR_DETAILS_);
+			}
+		});
+	}
+
+	this->_run_shard(0);
+}
+
+void ShardedHTTPServer::close()
+{
+	for (const auto& socket : this->_sockets)
+	{
+		util::close_socket(socket.get(), this->context.logger);
+	}
+
+	// Shards close their connections after the next timeout when
+	// sockets are closed.
+	for (auto& thread : this->_shard_threads)
+	{
+		if (thread.joinable() && thread.get_id() != std::this_thread::get_id())
+		{
+			thread.join();
+		}
+	}
+
+	this->_shard_threads.clear();
+}
+
+void ShardedHTTPServer::initialize_environment()
+{
+	this->environment.insert(std::make_pair(net::meta::SERVER_NAME, this->server_name));
+	this->environment.insert(std::make_pair(net::meta::SERVER_PORT, std::to_string(this->server_port)));
+}
+
+void ShardedHTTPServer::_run_shard(size_t index)
+{
+	util::pin_current_thread_to_cpu(index);
+
+	// Allocated after pinning, so memory of the shard is local to its
+	// core.
+	auto* socket = this->_sockets[index].get();
+	ConnectionLimiter limiter(
+		this->context.connections_high_watermark, this->context.connections_low_watermark, this->_sockets.size()
+	);
+	Reactor reactor(this->context, this->environment, &limiter, nullptr);
+	limiter.set_resume_listener([&reactor]() { reactor.update_listeners(); });
+	reactor.add_listener(socket->raw_socket());
+
+	auto timeout_milliseconds = (int)(
+		this->context.timeout_seconds * 1000 + this->context.timeout_microseconds / 1000
+	);
+	while (socket->is_open())
+	{
+		reactor.poll(timeout_milliseconds);
+	}
+
+	reactor.close();
+}
+
+__SERVER_END__
+
+#endif // __linux__
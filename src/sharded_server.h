@@ -0,0 +1,92 @@
+/**
+ * sharded_server.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * HTTP server which runs an independent event loop on each CPU core.
+ */
+
+#pragma once
+
+#if defined(__linux__)
+
+// C++ libraries.
+#include <string>
+#include <memory>
+#include <map>
+#include <thread>
+#include <vector>
+
+// Base libraries.
+#include <xalwart.base/interfaces/server.h>
+
+// Module definitions.
+#include "./_def_.h"
+
+// Server libraries.
+#include "./interfaces.h"
+#include "./context.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: ShardedHTTPServer
+// Thread-per-core server. Each shard is a thread pinned to its own CPU
+// core with its own 'SO_REUSEPORT' listener, 'Reactor', connection
+// limiter and connection table. Requests are handled by the thread of
+// the shard which accepted the connection, so nothing is shared
+// between shards and 'Context::worker' is not used.
+//
+// The count of shards is 'Context::acceptors_count'. Because handlers
+// run on the event loop, a handler which blocks delays all connections
+// of its shard. For synchronous handlers zero 'body_read' and 'write'
+// stage timeouts are set to the timeout of a single operation, so a
+// slow client can not hold the shard longer than that.
+class ShardedHTTPServer : public IServer
+{
+public:
+	explicit ShardedHTTPServer(Context context);
+
+	void bind(const std::string& address, uint16_t port) override;
+
+	void listen(const std::string& message) override;
+
+	void close() override;
+
+	[[nodiscard]]
+	inline std::map<std::string, std::string> get_environment() const override
+	{
+		return this->environment;
+	}
+
+	[[nodiscard]]
+	inline bool is_development() const override
+	{
+		return true;
+	}
+
+protected:
+	std::string host;
+	std::string server_name;
+	uint16_t server_port = 0;
+	std::map<std::string, std::string> environment;
+	Context context;
+
+	void initialize_environment() override;
+
+private:
+	// Listening socket of each shard.
+	std::vector<std::unique_ptr<ISocket>> _sockets;
+
+	// Threads of shards except the first one, which is served by the
+	// thread that calls 'listen'.
+	std::vector<std::thread> _shard_threads;
+
+	// Event loop of the shard with 'index'. State of the shard is
+	// created by its own thread after it is pinned to the core.
+	void _run_shard(size_t index);
+};
+
+__SERVER_END__
+
+#endif // __linux__
@@ -0,0 +1,244 @@
+/**
+ * simd.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./simd.h"
+
+// C++ libraries.
+#include <array>
+#include <cstdint>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define __SERVER_HAS_AVX2_DISPATCH__
+#endif
+
+
+__SERVER_UTIL_BEGIN__
+
+// Token characters of RFC 7230: "!#$%&'*+-.^_`|~", digits and letters.
+static constexpr bool is_token_char(unsigned char c)
+{
+	if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+	{
+		return true;
+	}
+
+	switch (c)
+	{
+		case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+':
+		case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+			return true;
+		default:
+			return false;
+	}
+}
+
+static constexpr auto TOKEN_CHARS = []
+{
+	std::array<bool, 256> table{};
+	for (size_t c = 0; c < table.size(); c++)
+	{
+		table[c] = is_token_char((unsigned char)c);
+	}
+
+	return table;
+}();
+
+static const char* find_non_token_scalar(const char* begin, const char* end)
+{
+	while (begin != end && TOKEN_CHARS[(unsigned char)*begin])
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+static const char* find_control_scalar(const char* begin, const char* end, bool stop_at_space)
+{
+	unsigned char first_allowed = stop_at_space ? 0x21 : 0x20;
+	for (; begin != end; begin++)
+	{
+		auto c = (unsigned char)*begin;
+		if (c < first_allowed || c == 0x7F)
+		{
+			break;
+		}
+	}
+
+	return begin;
+}
+
+#if defined(__SSE2__)
+static const char* find_control_sse2(const char* begin, const char* end, bool stop_at_space)
+{
+	// Bytes which are not above the last control character.
+	auto last_control = _mm_set1_epi8(stop_at_space ? 0x20 : 0x1F);
+	auto del = _mm_set1_epi8(0x7F);
+	for (; end - begin >= 16; begin += 16)
+	{
+		auto chunk = _mm_loadu_si128((const __m128i*)begin);
+		auto is_control = _mm_or_si128(
+			_mm_cmpeq_epi8(_mm_min_epu8(chunk, last_control), chunk), _mm_cmpeq_epi8(chunk, del)
+		);
+		auto mask = _mm_movemask_epi8(is_control);
+		if (mask)
+		{
+			return begin + __builtin_ctz(mask);
+		}
+	}
+
+	return find_control_scalar(begin, end, stop_at_space);
+}
+#endif
+
+#if defined(__SERVER_HAS_AVX2_DISPATCH__)
+// Bit 'h - 2' of entry 'l' is set if the byte with high nibble 'h' and
+// low nibble 'l' is a token character, all of them are in [0x20, 0x80).
+static constexpr auto TOKEN_BITMAP = []
+{
+	std::array<uint8_t, 16> table{};
+	for (size_t c = 0x20; c < 0x80; c++)
+	{
+		if (TOKEN_CHARS[c])
+		{
+			table[c & 0x0F] |= 1 << ((c >> 4) - 2);
+		}
+	}
+
+	return table;
+}();
+
+static constexpr std::array<uint8_t, 16> HIGH_NIBBLE_BITS{0, 0, 1, 2, 4, 8, 16, 32, 0, 0, 0, 0, 0, 0, 0, 0};
+
+// Ranges of bytes which are not token characters except '|' and '~'
+// in the last one, which are checked by the table.
+alignas(16) static constexpr std::array<char, 16> NON_TOKEN_RANGES{
+	'\x00', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', '\xff'
+};
+
+__attribute__((target("sse4.2")))
+static const char* find_non_token_sse42(const char* begin, const char* end)
+{
+	auto ranges = _mm_load_si128((const __m128i*)NON_TOKEN_RANGES.data());
+	while (end - begin >= 16)
+	{
+		auto chunk = _mm_loadu_si128((const __m128i*)begin);
+		auto index = _mm_cmpestri(
+			ranges, (int)NON_TOKEN_RANGES.size(), chunk, 16,
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT
+		);
+		begin += index;
+		if (index != 16)
+		{
+			if (!TOKEN_CHARS[(unsigned char)*begin])
+			{
+				return begin;
+			}
+
+			begin++;
+		}
+	}
+
+	return find_non_token_scalar(begin, end);
+}
+
+__attribute__((target("avx2")))
+static const char* find_non_token_avx2(const char* begin, const char* end)
+{
+	auto bitmap = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)TOKEN_BITMAP.data()));
+	auto high_nibble_bits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)HIGH_NIBBLE_BITS.data()));
+	auto low_nibble = _mm256_set1_epi8(0x0F);
+	auto zero = _mm256_setzero_si256();
+	for (; end - begin >= 32; begin += 32)
+	{
+		auto chunk = _mm256_loadu_si256((const __m256i*)begin);
+		auto rows = _mm256_shuffle_epi8(bitmap, _mm256_and_si256(chunk, low_nibble));
+		auto columns = _mm256_shuffle_epi8(
+			high_nibble_bits, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), low_nibble)
+		);
+		auto is_not_token = _mm256_cmpeq_epi8(_mm256_and_si256(rows, columns), zero);
+		auto mask = (uint32_t)_mm256_movemask_epi8(is_not_token);
+		if (mask)
+		{
+			return begin + __builtin_ctz(mask);
+		}
+	}
+
+	return find_non_token_scalar(begin, end);
+}
+
+__attribute__((target("avx2")))
+static const char* find_control_avx2(const char* begin, const char* end, bool stop_at_space)
+{
+	auto last_control = _mm256_set1_epi8(stop_at_space ? 0x20 : 0x1F);
+	auto del = _mm256_set1_epi8(0x7F);
+	for (; end - begin >= 32; begin += 32)
+	{
+		auto chunk = _mm256_loadu_si256((const __m256i*)begin);
+		auto is_control = _mm256_or_si256(
+			_mm256_cmpeq_epi8(_mm256_min_epu8(chunk, last_control), chunk), _mm256_cmpeq_epi8(chunk, del)
+		);
+		auto mask = (uint32_t)_mm256_movemask_epi8(is_control);
+		if (mask)
+		{
+			return begin + __builtin_ctz(mask);
+		}
+	}
+
+	return find_control_scalar(begin, end, stop_at_space);
+}
+#endif
+
+using FindNonTokenFunction = const char* (*)(const char*, const char*);
+
+static FindNonTokenFunction select_find_non_token()
+{
+#if defined(__SERVER_HAS_AVX2_DISPATCH__)
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return find_non_token_avx2;
+	}
+
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		return find_non_token_sse42;
+	}
+#endif
+
+	return find_non_token_scalar;
+}
+
+const char* find_non_token(const char* begin, const char* end)
+{
+	static const FindNonTokenFunction implementation = select_find_non_token();
+	return implementation(begin, end);
+}
+
+using FindControlFunction = const char* (*)(const char*, const char*, bool);
+
+static FindControlFunction select_find_control()
+{
+#if defined(__SERVER_HAS_AVX2_DISPATCH__)
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return find_control_avx2;
+	}
+#endif
+
+#if defined(__SSE2__)
+	return find_control_sse2;
+#else
+	return find_control_scalar;
+#endif
+}
+
+const char* find_control(const char* begin, const char* end, bool stop_at_space)
+{
+	static const FindControlFunction implementation = select_find_control();
+	return implementation(begin, end, stop_at_space);
+}
+
+__SERVER_UTIL_END__
@@ -0,0 +1,138 @@
+/**
+ * simd.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Vectorized scanning of received data.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Module definitions.
+#include "./_def_.h"
+
+
+__SERVER_UTIL_BEGIN__
+
+// TESTME: find_non_token
+// Returns the first byte in ['begin', 'end') which is not a token
+// character of RFC 7230, e.g. the end of a method or a header name, or
+// 'end'. Classifies 32 bytes at a time with AVX2 or checks 16 bytes
+// against ranges with SSE4.2 if the CPU supports them.
+extern const char* find_non_token(const char* begin, const char* end);
+
+// TESTME: find_control
+// Returns the first control character in ['begin', 'end') or 'end',
+// the space is a control character if 'stop_at_space' is set. Bytes
+// above 0x7F are not control characters. Finds the end of a request
+// target or a header value, the caller checks which character ends
+// it.
+extern const char* find_control(const char* begin, const char* end, bool stop_at_space);
+
+namespace internal
+{
+
+#if defined(__SSE2__)
+// Compares the first 64 bytes of the range, which holds at least them.
+// Short lines end in the first vectors, which are compared one by one.
+// The rest is compared with a single branch, so lines which are just
+// longer than the prefix do not pay for a branch per vector. Returns
+// nullptr if 'byte' is not found.
+inline const char* find_byte_prefix_sse2(const char* begin, char byte)
+{
+	auto pattern = _mm_set1_epi8(byte);
+	for (size_t offset = 0; offset < 32; offset += 16)
+	{
+		auto chunk = _mm_loadu_si128((const __m128i*)(begin + offset));
+		auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+		if (mask)
+		{
+			return begin + offset + __builtin_ctz(mask);
+		}
+	}
+
+	auto match2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(begin + 32)), pattern);
+	auto match3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(begin + 48)), pattern);
+	auto mask = (uint32_t)_mm_movemask_epi8(match2) | ((uint32_t)_mm_movemask_epi8(match3) << 16);
+	return mask ? begin + 32 + __builtin_ctz(mask) : nullptr;
+}
+
+// Compares the range by 16 bytes, the tail which is shorter than a
+// vector is skipped. Returns nullptr if 'byte' is not found.
+inline const char* find_byte_sse2(const char* begin, const char* end, char byte)
+{
+	auto pattern = _mm_set1_epi8(byte);
+	for (; end - begin >= 16; begin += 16)
+	{
+		auto chunk = _mm_loadu_si128((const __m128i*)begin);
+		auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+		if (mask)
+		{
+			return begin + __builtin_ctz(mask);
+		}
+	}
+
+	return nullptr;
+}
+#endif
+
+};
+
+// TESTME: find_byte
+// Returns the first occurrence of 'byte' in ['begin', 'end') or 'end'.
+//
+// Up to 64 bytes are compared inline with SSE2, which is faster than a
+// call for short header lines. Longer ranges go to 'memchr': vectorized
+// implementations of the C library were not slower than a custom AVX2
+// scan on any length.
+inline const char* find_byte(const char* begin, const char* end, char byte)
+{
+#if defined(__SSE2__)
+	constexpr ptrdiff_t prefix_size = 64;
+	if (end - begin >= prefix_size)
+	{
+		if (auto* result = internal::find_byte_prefix_sse2(begin, byte))
+		{
+			return result;
+		}
+
+		begin += prefix_size;
+	}
+	else
+	{
+		if (auto* result = internal::find_byte_sse2(begin, end, byte))
+		{
+			return result;
+		}
+
+		begin += (end - begin) & ~(ptrdiff_t)15;
+	}
+#endif
+	if (begin == end)
+	{
+		return end;
+	}
+
+	auto* result = (const char*)std::memchr(begin, byte, end - begin);
+	return result ? result : end;
+}
+
+// TESTME: find_line_end
+// Returns the position after the first '\n' in ['begin', 'end') or
+// nullptr if the range has no complete line.
+inline const char* find_line_end(const char* begin, const char* end)
+{
+	auto* result = find_byte(begin, end, '\n');
+	return result == end ? nullptr : result + 1;
+}
+
+__SERVER_UTIL_END__
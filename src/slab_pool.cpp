@@ -0,0 +1,299 @@
+/**
+ * slab_pool.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./slab_pool.h"
+
+// C++ libraries.
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <new>
+
+
+__SERVER_BEGIN__
+
+static constexpr size_t CLASSES_COUNT = SlabPool::CLASS_SIZES.size();
+static constexpr std::align_val_t BLOCK_ALIGNMENT{64};
+
+// Bytes of each class cached by a thread and by the depot.
+static constexpr size_t THREAD_CACHE_SIZE = 256 * 1024;
+static constexpr size_t DEPOT_SIZE = 16 * THREAD_CACHE_SIZE;
+
+// Released blocks are linked through their first bytes.
+struct FreeList
+{
+	struct Block
+	{
+		Block* next;
+	};
+
+	Block* head = nullptr;
+	size_t count = 0;
+
+	inline void push(void* block)
+	{
+		auto* node = (Block*)block;
+		node->next = this->head;
+		this->head = node;
+		this->count++;
+	}
+
+	inline void* pop()
+	{
+		auto* node = this->head;
+		if (node)
+		{
+			this->head = node->next;
+			this->count--;
+		}
+
+		return node;
+	}
+};
+
+// Classes up to 4 KiB are powers of two from 64 bytes.
+static size_t class_index(size_t size)
+{
+	if (size <= 4096)
+	{
+		return size <= 64 ? 0 : std::bit_width(size - 1) - 6;
+	}
+
+	if (size <= 16384)
+	{
+		return 7;
+	}
+
+	return size <= 65536 ? 8 : CLASSES_COUNT;
+}
+
+static size_t blocks_limit(size_t index, size_t bytes)
+{
+	return std::max(bytes / SlabPool::CLASS_SIZES[index], (size_t)4);
+}
+
+static void* allocate_block(size_t index)
+{
+	return ::operator new(SlabPool::CLASS_SIZES[index], BLOCK_ALIGNMENT);
+}
+
+static void free_block(void* block)
+{
+	::operator delete(block, BLOCK_ALIGNMENT);
+}
+
+struct Depot
+{
+	std::mutex mutex;
+	std::array<FreeList, CLASSES_COUNT> lists;
+
+	// Moves up to 'count' blocks to 'destination'.
+	void take(size_t index, FreeList& destination, size_t count)
+	{
+		std::lock_guard lock(this->mutex);
+		auto& list = this->lists[index];
+		while (count-- > 0 && list.count > 0)
+		{
+			destination.push(list.pop());
+		}
+	}
+
+	// Moves 'count' blocks from 'source', blocks above the limit of the
+	// depot are freed.
+	void put(size_t index, FreeList& source, size_t count)
+	{
+		FreeList excess;
+		{
+			std::lock_guard lock(this->mutex);
+			auto& list = this->lists[index];
+			auto limit = blocks_limit(index, DEPOT_SIZE);
+			while (count-- > 0 && source.count > 0)
+			{
+				(list.count < limit ? list : excess).push(source.pop());
+			}
+		}
+
+		while (auto* block = excess.pop())
+		{
+			free_block(block);
+		}
+	}
+};
+
+struct ThreadCache;
+
+struct Registry
+{
+	std::mutex mutex;
+	std::vector<ThreadCache*> caches;
+
+	// Statistics of finished threads.
+	std::array<uint64_t, CLASSES_COUNT> hits{};
+	std::array<uint64_t, CLASSES_COUNT> misses{};
+};
+
+// Never destroyed, threads may release blocks during the exit of the
+// process.
+static Depot& depot()
+{
+	static auto* instance = new Depot();
+	return *instance;
+}
+
+static Registry& registry()
+{
+	static auto* instance = new Registry();
+	return *instance;
+}
+
+static thread_local bool thread_cache_is_destroyed = false;
+
+struct ThreadCache
+{
+	std::array<FreeList, CLASSES_COUNT> lists;
+
+	// Written by the owner only, read by 'SlabPool::stats'.
+	std::array<std::atomic<uint64_t>, CLASSES_COUNT> hits{};
+	std::array<std::atomic<uint64_t>, CLASSES_COUNT> misses{};
+
+	inline ThreadCache()
+	{
+		auto& registry = server::registry();
+		std::lock_guard lock(registry.mutex);
+		registry.caches.push_back(this);
+	}
+
+	inline ~ThreadCache()
+	{
+		thread_cache_is_destroyed = true;
+		for (size_t i = 0; i < CLASSES_COUNT; i++)
+		{
+			depot().put(i, this->lists[i], this->lists[i].count);
+		}
+
+		auto& registry = server::registry();
+		std::lock_guard lock(registry.mutex);
+		std::erase(registry.caches, this);
+		for (size_t i = 0; i < CLASSES_COUNT; i++)
+		{
+			registry.hits[i] += this->hits[i].load(std::memory_order_relaxed);
+			registry.misses[i] += this->misses[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	static inline void increment(std::atomic<uint64_t>& counter)
+	{
+		// The counter has a single writer, so it is not locked.
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+};
+
+// Returns nullptr while the cache of the exiting thread is destroyed.
+static ThreadCache* thread_cache()
+{
+	if (thread_cache_is_destroyed)
+	{
+		return nullptr;
+	}
+
+	static thread_local ThreadCache cache;
+	return &cache;
+}
+
+void* SlabPool::allocate(size_t size)
+{
+	auto index = class_index(size);
+	if (index == CLASSES_COUNT)
+	{
+		return ::operator new(size, BLOCK_ALIGNMENT);
+	}
+
+	auto* cache = thread_cache();
+	if (!cache)
+	{
+		return allocate_block(index);
+	}
+
+	auto& list = cache->lists[index];
+	if (list.count == 0)
+	{
+		depot().take(index, list, blocks_limit(index, THREAD_CACHE_SIZE) / 2);
+	}
+
+	if (auto* block = list.pop())
+	{
+		ThreadCache::increment(cache->hits[index]);
+		return block;
+	}
+
+	ThreadCache::increment(cache->misses[index]);
+	return allocate_block(index);
+}
+
+void SlabPool::deallocate(void* block, size_t size) noexcept
+{
+	if (!block)
+	{
+		return;
+	}
+
+	auto index = class_index(size);
+	if (index == CLASSES_COUNT)
+	{
+		::operator delete(block, BLOCK_ALIGNMENT);
+		return;
+	}
+
+	auto* cache = thread_cache();
+	if (!cache)
+	{
+		FreeList list;
+		list.push(block);
+		depot().put(index, list, 1);
+		return;
+	}
+
+	auto& list = cache->lists[index];
+	list.push(block);
+	auto limit = blocks_limit(index, THREAD_CACHE_SIZE);
+	if (list.count > limit)
+	{
+		depot().put(index, list, limit / 2);
+	}
+}
+
+size_t SlabPool::block_size(size_t size)
+{
+	auto index = class_index(size);
+	return index == CLASSES_COUNT ? size : CLASS_SIZES[index];
+}
+
+std::vector<SlabPool::ClassStats> SlabPool::stats()
+{
+	auto& registry = server::registry();
+	std::lock_guard lock(registry.mutex);
+	std::vector<ClassStats> result;
+	for (size_t i = 0; i < CLASSES_COUNT; i++)
+	{
+		ClassStats stats{
+			.block_size = CLASS_SIZES[i],
+			.hits = registry.hits[i],
+			.misses = registry.misses[i]
+		};
+		for (const auto* cache : registry.caches)
+		{
+			stats.hits += cache->hits[i].load(std::memory_order_relaxed);
+			stats.misses += cache->misses[i].load(std::memory_order_relaxed);
+		}
+
+		result.push_back(stats);
+	}
+
+	return result;
+}
+
+__SERVER_END__
@@ -0,0 +1,100 @@
+/**
+ * slab_pool.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Pool of fixed-size blocks for I/O buffers and connection objects.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Module definitions.
+#include "./_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: SlabPool
+// Allocates blocks of fixed size classes: small ones for connection
+// objects and 4, 16 and 64 KiB ones for I/O buffers. Released blocks
+// are cached by the releasing thread, so allocation and release do not
+// lock. A thread moves half of its cache to a shared depot when the
+// cache is full and takes blocks from the depot when it is empty, so
+// blocks allocated by an acceptor and released by workers return to
+// the acceptor in batches.
+//
+// Sizes above the largest class are allocated with 'operator new'.
+class SlabPool final
+{
+public:
+	static constexpr std::array<size_t, 9> CLASS_SIZES{
+		64, 128, 256, 512, 1024, 2048, 4096, 16384, 65536
+	};
+
+	struct ClassStats
+	{
+		size_t block_size;
+
+		// Allocations served from a cache or the depot.
+		uint64_t hits;
+
+		// Allocations which requested memory from the system.
+		uint64_t misses;
+	};
+
+	SlabPool() = delete;
+
+	// Returns a block of at least 'size' bytes aligned to 64 bytes.
+	static void* allocate(size_t size);
+
+	// 'size' should be the same as passed to 'allocate'.
+	static void deallocate(void* block, size_t size) noexcept;
+
+	// Returns the size of the block allocated for 'size' bytes.
+	[[nodiscard]]
+	static size_t block_size(size_t size);
+
+	// Statistics of all threads, including finished ones.
+	[[nodiscard]]
+	static std::vector<ClassStats> stats();
+};
+
+// TESTME: PoolAllocator
+// Standard allocator on top of 'SlabPool', used with
+// 'std::allocate_shared'.
+template <typename T>
+struct PoolAllocator
+{
+	using value_type = T;
+
+	PoolAllocator() noexcept = default;
+
+	template <typename U>
+	inline PoolAllocator(const PoolAllocator<U>&) noexcept
+	{
+	}
+
+	inline T* allocate(size_t count)
+	{
+		return (T*)SlabPool::allocate(count * sizeof(T));
+	}
+
+	inline void deallocate(T* pointer, size_t count) noexcept
+	{
+		SlabPool::deallocate(pointer, count * sizeof(T));
+	}
+
+	template <typename U>
+	inline bool operator== (const PoolAllocator<U>&) const noexcept
+	{
+		return true;
+	}
+};
+
+__SERVER_END__
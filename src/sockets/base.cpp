@@ -9,6 +9,8 @@
 // C++ libraries.
 #include <fcntl.h>
 #if defined(__linux__) || defined(__APPLE__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #elif _WIN32
@@ -22,11 +24,15 @@
 
 __SERVER_BEGIN__
 
-void BaseSocket::set_options()
+void BaseSocket::set_options(const SocketOptions& options)
 {
-	int options = 1;
-	::setsockopt(this->socket, SOL_SOCKET, SO_REUSEADDR, &options, sizeof(options));
-	if (::setsockopt(this->socket, SOL_SOCKET, SO_REUSEPORT, &options, sizeof(options)))
+	this->backlog = options.backlog > 0 ? options.backlog : SOMAXCONN;
+	this->set_option(SOL_SOCKET, SO_RCVBUF, options.receive_buffer_size);
+	this->set_option(SOL_SOCKET, SO_SNDBUF, options.send_buffer_size);
+
+	int is_enabled = 1;
+	::setsockopt(this->socket, SOL_SOCKET, SO_REUSEADDR, &is_enabled, sizeof(is_enabled));
+	if (::setsockopt(this->socket, SOL_SOCKET, SO_REUSEPORT, &is_enabled, sizeof(is_enabled)))
 	{
 		auto error_code = errno;
 		switch (error_code)
@@ -52,7 +58,7 @@ void BaseSocket::set_options()
 
 void BaseSocket::listen() const
 {
-	if (::listen(this->socket, SOMAXCONN))
+	if (::listen(this->socket, this->backlog))
 	{
 		throw SocketError(errno, "'listen' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
 	}
@@ -74,6 +80,40 @@ void BaseSocket::close()
 	::close(this->socket);
 }
 
+void BaseSocket::set_option(int level, int name, int value) const
+{
+	if (value == 0)
+	{
+		return;
+	}
+
+	if (::setsockopt(this->socket, level, name, &value, sizeof(value)))
+	{
+		auto error_code = errno;
+		switch (error_code)
+		{
+			case ENOPROTOOPT:
+			case EOPNOTSUPP:
+				break;
+			default:
+				throw SocketError(
+					error_code, "'setsockopt' call failed: " + std::to_string(error_code), _ERROR_DETAILS_
+				);
+		}
+	}
+}
+
+void BaseSocket::set_tcp_options(const SocketOptions& options) const
+{
+	this->set_option(IPPROTO_TCP, TCP_NODELAY, options.no_delay);
+#if defined(__linux__)
+	this->set_option(IPPROTO_TCP, TCP_DEFER_ACCEPT, options.defer_accept_seconds);
+#endif
+#if defined(TCP_FASTOPEN)
+	this->set_option(IPPROTO_TCP, TCP_FASTOPEN, options.fast_open_queue_length);
+#endif
+}
+
 bool BaseSocket::_set_blocking(bool blocking) const
 {
 	if (!util::socket_is_valid(this->socket))
@@ -93,7 +133,7 @@ bool BaseSocket::_set_blocking(bool blocking) const
 }
 
 BaseSocket::BaseSocket(const char* address, uint16_t port, int family) :
-	address(address), port(port), family(family), _closed(false)
+	address(address), port(port), family(family), backlog(SOMAXCONN), _closed(false)
 {
 	this->socket = ::socket(this->family, SOCK_STREAM, 0);
 	if (!util::socket_is_valid(this->socket))
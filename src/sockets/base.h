@@ -25,7 +25,7 @@ class BaseSocket : public ISocket
 {
 public:
 	// Overridden method must call `BaseSocket::set_options()`
-	void set_options() override;
+	void set_options(const SocketOptions& options={}) override;
 
 	void listen() const override;
 
@@ -50,8 +50,18 @@ protected:
 	std::string address;
 	uint16_t port;
 
+	// Set by 'set_options'.
+	int backlog;
+
 	explicit BaseSocket(const char* address, uint16_t port, int family);
 
+	// Sets an option which is required to be supported if 'value' is not
+	// zero. Options unknown to the system are skipped.
+	void set_option(int level, int name, int value) const;
+
+	// Listener options of TCP sockets, called before binding.
+	void set_tcp_options(const SocketOptions& options) const;
+
 private:
 	bool _closed;
 
@@ -8,78 +8,211 @@
 
 // C++ libraries.
 #include <cstring>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <utility>
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#endif
 
 // Base libraries.
 #include <xalwart.base/net/_def_.h>
 
 // Server libraries.
+#include "../chunked_body.h"
 #include "../exceptions.h"
+#include "../simd.h"
+#include "../uring.h"
 
 
 __SERVER_BEGIN__
 
+#if defined(__linux__)
+// Values of user data of ring operations, zero is reserved for
+// operations which completions are ignored.
+enum RingOperation : uint64_t
+{
+	Send = 1, Receive, Timeout, Shutdown
+};
+#endif
+
 SocketIO::SocketIO(Socket file_descriptor, timeval timeout, std::unique_ptr<ISelector> selector) :
 	_file_descriptor(file_descriptor),
 	_timeout(timeout),
+	_read_deadline(std::chrono::steady_clock::time_point::max()),
+	_write_deadline(std::chrono::steady_clock::time_point::max()),
 	_selector(std::move(selector)),
-	_limit(-1)
+	_limit(-1),
+	_receive_size(MIN_RECEIVE_SIZE),
+	_cork_responses(false),
+	_is_corked(false),
+	_quick_ack(false),
+	_write_buffer_size(0),
+	_is_pipelined(false),
+	_zero_copy_threshold(0),
+	_zero_copy_sent_count(0),
+	_zero_copy_released_count(0),
+	_pipe{-1, -1},
+	_piped_count(0),
+	_piped_file(-1),
+	_piped_offset(0),
+	_ring(nullptr),
+	_queued_operations_count(0)
 {
 	this->_selector->register_read_event();
 }
 
+SocketIO::SocketIO(Socket file_descriptor, timeval timeout, IOUring* ring) :
+	_file_descriptor(file_descriptor),
+	_timeout(timeout),
+	_read_deadline(std::chrono::steady_clock::time_point::max()),
+	_write_deadline(std::chrono::steady_clock::time_point::max()),
+	_selector(nullptr),
+	_limit(-1),
+	_receive_size(MIN_RECEIVE_SIZE),
+	_cork_responses(false),
+	_is_corked(false),
+	_quick_ack(false),
+	_write_buffer_size(0),
+	_is_pipelined(false),
+	_zero_copy_threshold(0),
+	_zero_copy_sent_count(0),
+	_zero_copy_released_count(0),
+	_pipe{-1, -1},
+	_piped_count(0),
+	_piped_file(-1),
+	_piped_offset(0),
+	_ring(require_non_null(ring, "'ring' is nullptr", _ERROR_DETAILS_)),
+	_queued_operations_count(0)
+{
+}
+
+SocketIO::~SocketIO()
+{
+	// Operations left in the ring of the current thread would be reaped
+	// by the next stream otherwise.
+	if (this->_ring && this->_queued_operations_count > 0)
+	{
+		try
+		{
+			this->_write_queue.clear();
+			this->submit_to_ring(0);
+		}
+		catch (const SocketError&)
+		{
+		}
+	}
+
+	this->close_pipe();
+}
+
 SocketIO& SocketIO::operator= (SocketIO&& other) noexcept
 {
 	this->_file_descriptor = other._file_descriptor;
 	this->_timeout = other._timeout;
+	this->_read_deadline = other._read_deadline;
+	this->_write_deadline = other._write_deadline;
 	this->_selector = std::move(other._selector);
 	if (!this->buffer_is_empty())
 	{
-		this->_buffer = other._buffer;
+		this->_buffer = std::move(other._buffer);
 	}
 
 	this->_limit = other._limit;
+	this->_head_parser = std::move(other._head_parser);
+	this->_receive_size = other._receive_size;
+	this->_pending_writes = std::move(other._pending_writes);
+	this->_cork_responses = other._cork_responses;
+	this->_is_corked = other._is_corked;
+	this->_quick_ack = other._quick_ack;
+	this->_write_buffer_size = other._write_buffer_size;
+	this->_is_pipelined = other._is_pipelined;
+	this->_zero_copy_threshold = other._zero_copy_threshold;
+	this->_zero_copy_sent_count = other._zero_copy_sent_count;
+	this->_zero_copy_released_count = other._zero_copy_released_count;
+	this->close_pipe();
+	this->_pipe[0] = std::exchange(other._pipe[0], -1);
+	this->_pipe[1] = std::exchange(other._pipe[1], -1);
+	this->_piped_count = std::exchange(other._piped_count, 0);
+	this->_piped_file = other._piped_file;
+	this->_piped_offset = other._piped_offset;
+	this->_ring = other._ring;
+	this->_write_queue = std::move(other._write_queue);
+	this->_queued_operations_count = other._queued_operations_count;
+	other._queued_operations_count = 0;
 	return *this;
 }
 
 ssize_t SocketIO::read_line(std::string& line)
 {
-	ssize_t total_bytes_read_count = 0;
+	// Received parts of the line are moved to 'line', so the buffer
+	// does not grow and each byte is scanned once. The line is complete
+	// at '\n', so a "\r\n" split between reads is found as well.
 	line.clear();
-	bool new_line_reached = false;
-	while (!new_line_reached)
+	while (this->readable_count(1) > 0)
 	{
-		bool is_read = true;
-		if (this->read_allowed())
+		auto buffer = this->readable_view();
+		auto* line_end = util::find_line_end(buffer.data(), buffer.data() + buffer.size());
+		auto count = line_end ? (size_t)(line_end - buffer.data()) : buffer.size();
+		line.append(buffer.data(), count);
+		this->consume(count);
+		if (line_end || this->readable_count(1) == 0 || !this->read_bytes(net::DEFAULT_BUFFER_SIZE))
 		{
-			is_read = this->read_bytes(net::DEFAULT_BUFFER_SIZE);
+			break;
 		}
+	}
+
+	return (ssize_t)line.size();
+}
+
+ssize_t SocketIO::read_line(std::string_view& line, size_t max_count)
+{
+	line = {};
+	max_count = this->readable_count(max_count);
+	if (max_count == 0)
+	{
+		return 0;
+	}
 
-		if (!is_read)
+	// The line is kept in the buffer, only received data is scanned
+	// after each read.
+	size_t scanned_count = 0;
+	const char* line_end;
+	while (true)
+	{
+		auto buffer = this->_buffer.view();
+		line_end = util::find_line_end(buffer.data() + scanned_count, buffer.data() + buffer.size());
+		if (line_end || buffer.size() >= max_count || !this->read_bytes(net::DEFAULT_BUFFER_SIZE))
 		{
 			break;
 		}
 
-		auto pos = this->_buffer.find("\r\n");
-		if (pos == std::string::npos)
-		{
-			total_bytes_read_count += this->append_from_buffer_to(line, -1);
-		}
-		else
-		{
-			ssize_t count = (ssize_t)pos + 2;
-			total_bytes_read_count += this->append_from_buffer_to(line, count);
-			new_line_reached = true;
-		}
+		scanned_count = buffer.size();
 	}
 
-	return total_bytes_read_count;
+	// The buffer is not changed after the last scan.
+	auto buffer = this->_buffer.view();
+	auto count = std::min(line_end ? (size_t)(line_end - buffer.data()) : buffer.size(), max_count);
+	line = buffer.substr(0, count);
+	this->consume(count);
+	return (ssize_t)count;
 }
 
 ssize_t SocketIO::read(std::string& buffer, size_t max_count)
 {
 	buffer.clear();
+	max_count = this->readable_count(max_count);
+	if (max_count == 0)
+	{
+		return 0;
+	}
+
 	bool is_read = true;
 	if (this->read_allowed())
 	{
@@ -94,9 +227,63 @@ ssize_t SocketIO::read(std::string& buffer, size_t max_count)
 	return 0;
 }
 
+ssize_t SocketIO::read(std::span<char> destination)
+{
+	destination = destination.first(this->readable_count(destination.size()));
+	if (destination.empty())
+	{
+		return 0;
+	}
+
+	if (this->buffer_is_empty())
+	{
+		// Small reads are buffered, so the next ones do not touch the
+		// socket.
+		if (!this->_ring && destination.size() >= MIN_RECEIVE_SIZE)
+		{
+			auto count = this->read_bytes(destination.size(), destination.data());
+			this->count_read_bytes(count);
+			return count;
+		}
+
+		if (!this->read_bytes(destination.size()))
+		{
+			return 0;
+		}
+	}
+
+	auto count = std::min(destination.size(), this->_buffer.size());
+	std::memcpy(destination.data(), this->_buffer.data(), count);
+	this->consume(count);
+	return (ssize_t)count;
+}
+
+ssize_t SocketIO::read(std::string_view& data, size_t max_count)
+{
+	data = {};
+	max_count = this->readable_count(max_count);
+	if (max_count == 0 || (this->buffer_is_empty() && !this->read_bytes(max_count)))
+	{
+		return 0;
+	}
+
+	auto count = std::min(max_count, this->_buffer.size());
+	data = this->_buffer.view().substr(0, count);
+
+	// The read cursor is moved, the data stays until the next read.
+	this->consume(count);
+	return (ssize_t)count;
+}
+
 ssize_t SocketIO::peek(std::string& buffer, size_t max_count)
 {
 	buffer.clear();
+	max_count = this->readable_count(max_count);
+	if (max_count == 0)
+	{
+		return 0;
+	}
+
 	bool is_read = true;
 	if (max_count - this->buffered() > 0)
 	{
@@ -113,117 +300,394 @@ ssize_t SocketIO::peek(std::string& buffer, size_t max_count)
 
 ssize_t SocketIO::write(const char* data, size_t count)
 {
-	ssize_t bytes_sent_count;
-	bool try_again;
-	do
+	if (this->_ring)
 	{
-		try_again = false;
-		bytes_sent_count = ::send(this->file_descriptor(), data, count, MSG_NOSIGNAL);
-		if (bytes_sent_count < 0)
+		this->_write_queue.append(data, count);
+		if (this->_write_queue.size() >= MAX_WRITE_QUEUE_SIZE)
 		{
-			auto error_code = errno;
-			switch (error_code)
-			{
-				case ETIMEDOUT:
-				case EAGAIN:
-					try_again = true;
-					break;
-				case ECONNRESET:
-					throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
-				case ENOTCONN:
-					throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
-				default:
-					throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
-			}
+			this->submit_to_ring(0);
 		}
+
+		return (ssize_t)count;
 	}
-	while (try_again);
-	return bytes_sent_count;
+
+	if (this->buffer(data, count))
+	{
+		if (this->write_buffer_is_full())
+		{
+			this->send_queued(nullptr, 0, true);
+		}
+
+		return (ssize_t)count;
+	}
+
+	// Sends the whole data, a non-blocking socket may accept a part.
+	return this->send_queued(data, count, true);
 }
 
-bool SocketIO::close_reader()
+bool SocketIO::buffer(const char* data, size_t count)
 {
-	return this->shutdown(SHUT_RD) == 0;
+	if (this->_ring || count == 0 || count >= this->write_buffer_size())
+	{
+		return false;
+	}
+
+	this->_pending_writes.append(data, count);
+	return true;
 }
 
-bool SocketIO::close_writer()
+void SocketIO::queue(const char* data, size_t count)
 {
-	return this->shutdown(SHUT_WR) == 0;
+	if (this->_ring)
+	{
+		this->write(data, count);
+	}
+	else
+	{
+		this->_pending_writes.append(data, count);
+	}
 }
 
-int SocketIO::shutdown(int how) const
+void SocketIO::queue(std::string data)
 {
-	return ::shutdown(this->file_descriptor(), how);
+	if (this->_ring)
+	{
+		this->write(data.data(), data.size());
+	}
+	else
+	{
+		this->_pending_writes.append(std::move(data));
+	}
 }
 
-ssize_t SocketIO::append_from_buffer_to(std::string& buffer, size_t max_count, bool erase)
+void SocketIO::queue_reference(const char* data, size_t count)
 {
-	auto count = (max_count < this->buffered()) ? max_count : this->buffered();
-	buffer += this->_buffer.substr(0, count);
-	if (erase)
+	if (this->_ring)
+	{
+		this->write(data, count);
+	}
+	else
+	{
+		this->_pending_writes.append_reference(data, count);
+	}
+}
+
+void SocketIO::flush()
+{
+	if (!this->_ring && !this->_pending_writes.empty())
+	{
+		this->send_queued(nullptr, 0, true);
+	}
+
+#if defined(__linux__)
+	if (this->_is_corked)
+	{
+		// Sends the last partial segment.
+		int is_enabled = 0;
+		::setsockopt(this->file_descriptor(), IPPROTO_TCP, TCP_CORK, &is_enabled, sizeof(is_enabled));
+		this->_is_corked = false;
+	}
+#endif
+}
+
+ssize_t SocketIO::send_file(int file_descriptor, off_t offset, size_t count)
+{
+	this->flush_before_file(true);
+	this->cork();
+	struct stat file_status{};
+	if (::fstat(file_descriptor, &file_status) < 0)
 	{
-		if (count < this->buffered())
+		throw FileError("'fstat' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
+	}
+
+	size_t bytes_sent_count = 0;
+	while (bytes_sent_count < count)
+	{
+		auto result = this->send_file_part(
+			file_descriptor, offset < 0 ? offset : offset + (off_t)bytes_sent_count, count - bytes_sent_count,
+			S_ISREG(file_status.st_mode)
+		);
+		if (result > 0)
 		{
-			this->_buffer = this->_buffer.substr(count);
+			bytes_sent_count += result;
+			continue;
 		}
-		else
+		else if (result == 0)
 		{
-			this->clear_buffer();
+			break;
+		}
+
+		auto error_code = errno;
+		switch (error_code)
+		{
+			case EINTR:
+				break;
+			case ENODATA:
+				this->wait_for_source(file_descriptor);
+				break;
+			case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+			case EWOULDBLOCK:
+#endif
+				this->wait_for_write();
+				break;
+			case ECONNRESET:
+				throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+			case ENOTCONN:
+				throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+			default:
+				throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
 		}
 	}
 
-	return (ssize_t)count;
+#if !defined(__linux__)
+	// The tail of the last chunk may be queued by the copy through user
+	// space.
+	if (!this->_pending_writes.empty())
+	{
+		this->send_queued(nullptr, 0, true);
+	}
+#endif
+
+	return (ssize_t)bytes_sent_count;
 }
 
-bool SocketIO::read_bytes(size_t max_count)
+ssize_t SocketIO::try_send_file(int file_descriptor, off_t offset, size_t count)
 {
-	bool try_again;
-	do
+	if (!this->flush_before_file(false))
 	{
-		auto bytes_count = max_count;
-		if (this->has_limit())
+		errno = EAGAIN;
+		return -1;
+	}
+
+	this->cork();
+	struct stat file_status{};
+	if (::fstat(file_descriptor, &file_status) < 0)
+	{
+		throw FileError("'fstat' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
+	}
+
+	size_t bytes_sent_count = 0;
+	while (bytes_sent_count < count)
+	{
+		auto result = this->send_file_part(
+			file_descriptor, offset < 0 ? offset : offset + (off_t)bytes_sent_count, count - bytes_sent_count,
+			S_ISREG(file_status.st_mode)
+		);
+		if (result > 0)
+		{
+			bytes_sent_count += result;
+			continue;
+		}
+		else if (result == 0)
 		{
-			bytes_count = std::min((size_t)this->limit(), bytes_count);
+			break;
 		}
 
-		bytes_count = std::min(net::DEFAULT_BUFFER_SIZE, bytes_count);
-		if (bytes_count == 0)
+		auto error_code = errno;
+		switch (error_code)
 		{
-			throw EoF("end of socket stream", _ERROR_DETAILS_);
+			case EINTR:
+				continue;
+			case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+			case EWOULDBLOCK:
+#endif
+				if (bytes_sent_count > 0)
+				{
+					return (ssize_t)bytes_sent_count;
+				}
+
+				errno = EAGAIN;
+				return -1;
+			case ENODATA:
+				if (bytes_sent_count > 0)
+				{
+					return (ssize_t)bytes_sent_count;
+				}
+
+				errno = ENODATA;
+				return -1;
+			case ECONNRESET:
+				throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+			case ENOTCONN:
+				throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+			default:
+				throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
 		}
+	}
 
-		try_again = false;
-		if (!this->_selector->select(this->_timeout.tv_sec, this->_timeout.tv_usec))
+	return (ssize_t)bytes_sent_count;
+}
+
+bool SocketIO::close_reader()
+{
+#if defined(__linux__)
+	if (this->_ring)
+	{
+		// Submitted with the next operation.
+		this->_ring->prepare_shutdown(this->file_descriptor(), SHUT_RD, RingOperation::Shutdown, false);
+		this->_queued_operations_count++;
+		return true;
+	}
+#endif
+
+	return this->shutdown(SHUT_RD) == 0;
+}
+
+bool SocketIO::close_writer()
+{
+	if (this->_ring)
+	{
+		try
+		{
+			this->submit_to_ring(0, SHUT_WR);
+			return true;
+		}
+		catch (const SocketError& exc)
+		{
+			errno = exc.error_code();
+			return false;
+		}
+	}
+
+	try
+	{
+		this->flush();
+	}
+	catch (const SocketError& exc)
+	{
+		errno = exc.error_code();
+		return false;
+	}
+
+	return this->shutdown(SHUT_WR) == 0;
+}
+
+void SocketIO::wait_for_write() const
+{
+	this->wait_for(this->file_descriptor(), POLLOUT);
+}
+
+void SocketIO::wait_for_source(int file_descriptor) const
+{
+	this->wait_for(file_descriptor, POLLIN);
+}
+
+short SocketIO::wait_for(int file_descriptor, short events) const
+{
+	pollfd descriptor{
+		.fd = file_descriptor,
+		.events = events
+	};
+	auto timeout = this->wait_timeout(this->_write_deadline);
+
+	// Interrupted polls continue with the time which is left.
+	auto deadline = std::chrono::steady_clock::now() +
+		std::chrono::seconds(timeout.tv_sec) + std::chrono::microseconds(timeout.tv_usec);
+	while (true)
+	{
+		auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		auto status = ::poll(&descriptor, 1, (int)std::max<std::chrono::milliseconds::rep>(left.count(), 0));
+		if (status > 0)
+		{
+			return descriptor.revents;
+		}
+		else if (status == 0)
 		{
 			throw SocketError(ETIMEDOUT, "Connection timed out", _ERROR_DETAILS_);
 		}
 
-		char buf[net::DEFAULT_BUFFER_SIZE];
-		auto len = ::read(this->file_descriptor(), buf, bytes_count);
-		if (len > 0)
+		auto error_code = errno;
+		if (error_code != EINTR)
 		{
-			if (this->has_limit())
-			{
-				this->_limit -= len;
-			}
+			throw SocketError(error_code, "'poll' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+		}
+	}
+}
 
-			this->_buffer += std::string(buf, len);
-			return true;
+ssize_t SocketIO::send_queued(const char* data, size_t count, bool wait)
+{
+	this->cork();
+	size_t data_sent_count = 0;
+	while (!this->_pending_writes.empty() || data_sent_count < count)
+	{
+		iovec vectors[MAX_WRITE_VECTORS];
+		auto vectors_count = this->_pending_writes.prepare(vectors, MAX_WRITE_VECTORS - 1);
+		size_t queued_count = 0;
+		for (size_t i = 0; i < vectors_count; i++)
+		{
+			queued_count += vectors[i].iov_len;
 		}
-		else if (len == 0)
+
+		// Data is pinned until the kernel releases it, which is awaited
+		// by blocking writes only. Buffers of the queue are freed or
+		// merged with later ones as soon as they are sent, so only the
+		// caller's 'data' is pinned and the queue is sent before it.
+		bool is_zero_copy = false;
+#if defined(__linux__)
+		is_zero_copy = wait && this->_zero_copy_threshold > 0 &&
+			count - data_sent_count >= this->_zero_copy_threshold;
+#endif
+
+		// 'data' follows the queue only if all of it fits the vectors.
+		if (
+			queued_count == this->_pending_writes.size() && data_sent_count < count &&
+			(!is_zero_copy || vectors_count == 0)
+		)
 		{
-			// EOF
-			return false;
+			vectors[vectors_count++] = iovec{
+				.iov_base = (void*)(data + data_sent_count),
+				.iov_len = count - data_sent_count
+			};
 		}
-		else if (len < 0)
+		else
+		{
+			is_zero_copy = false;
+		}
+
+		msghdr message{};
+		message.msg_iov = vectors;
+		message.msg_iovlen = vectors_count;
+		int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#if defined(__linux__)
+		if (is_zero_copy)
+		{
+			flags |= MSG_ZEROCOPY;
+		}
+#endif
+
+		auto bytes_sent_count = ::sendmsg(this->file_descriptor(), &message, flags);
+		if (bytes_sent_count < 0)
 		{
 			auto error_code = errno;
 			switch (error_code)
 			{
-				case ETIMEDOUT:
+				case EINTR:
+					continue;
+#if defined(__linux__)
+				case ENOBUFS:
+					if (!is_zero_copy)
+					{
+						throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
+					}
+
+					// Too much pinned memory, previous sends should be
+					// released first.
+					this->reap_zero_copy_completions(true);
+					continue;
+#endif
 				case EAGAIN:
-					try_again = true;
-					break;
+#if EWOULDBLOCK != EAGAIN
+				case EWOULDBLOCK:
+#endif
+					if (!wait)
+					{
+						return (ssize_t)data_sent_count;
+					}
+
+					this->wait_for_write();
+					continue;
 				case ECONNRESET:
 					throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
 				case ENOTCONN:
@@ -232,9 +696,882 @@ bool SocketIO::read_bytes(size_t max_count)
 					throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
 			}
 		}
+
+#if defined(__linux__)
+		if (is_zero_copy && bytes_sent_count > 0)
+		{
+			this->_zero_copy_sent_count++;
+		}
+#endif
+
+		auto queue_sent_count = std::min((size_t)bytes_sent_count, queued_count);
+		this->_pending_writes.consume(queue_sent_count);
+		data_sent_count += bytes_sent_count - queue_sent_count;
 	}
-	while (try_again);
-	return false;
+
+	// The data belongs to the caller, it should not be changed until the
+	// kernel releases it.
+	this->reap_zero_copy_completions(true);
+	return (ssize_t)data_sent_count;
+}
+
+void SocketIO::cork()
+{
+#if defined(__linux__)
+	if (this->_cork_responses && !this->_is_corked)
+	{
+		int is_enabled = 1;
+		::setsockopt(this->file_descriptor(), IPPROTO_TCP, TCP_CORK, &is_enabled, sizeof(is_enabled));
+		this->_is_corked = true;
+	}
+#endif
+}
+
+void SocketIO::reap_zero_copy_completions(bool wait)
+{
+#if defined(__linux__)
+	while (this->_zero_copy_released_count != this->_zero_copy_sent_count)
+	{
+		char control[128];
+		msghdr message{};
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+		if (::recvmsg(this->file_descriptor(), &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+		{
+			auto error_code = errno;
+			if (error_code == EINTR)
+			{
+				continue;
+			}
+			else if (error_code != EAGAIN && error_code != EWOULDBLOCK)
+			{
+				throw SocketError(error_code, "'recvmsg' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+			}
+			else if (!wait)
+			{
+				return;
+			}
+
+			// The error queue is reported as 'POLLERR'.
+			if (!(this->wait_for(this->file_descriptor(), 0) & POLLERR))
+			{
+				throw SocketError(EPIPE, "Connection closed before zero-copy data is released", _ERROR_DETAILS_);
+			}
+
+			// 'POLLERR' is also set by a pending error of the socket.
+			int socket_error = 0;
+			socklen_t length = sizeof(socket_error);
+			if (
+				::getsockopt(this->file_descriptor(), SOL_SOCKET, SO_ERROR, &socket_error, &length) == 0 &&
+				socket_error != 0
+			)
+			{
+				throw SocketError(socket_error, "Connection filed", _ERROR_DETAILS_);
+			}
+
+			continue;
+		}
+
+		for (auto* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+		{
+			if (
+				!(header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR) &&
+				!(header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR)
+			)
+			{
+				continue;
+			}
+
+			auto* error = (sock_extended_err*)CMSG_DATA(header);
+			if (error->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+			{
+				continue;
+			}
+
+			this->_zero_copy_released_count += error->ee_data - error->ee_info + 1;
+			if (error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+			{
+				// The kernel copied the data anyway, e.g. for loopback
+				// connections, so zero-copy only adds notifications.
+				this->_zero_copy_threshold = 0;
+			}
+		}
+	}
+#endif
+}
+
+ssize_t SocketIO::send_file_part(int file_descriptor, off_t offset, size_t count, bool is_regular_file)
+{
+#if defined(__linux__)
+	if (is_regular_file)
+	{
+		return ::sendfile(this->file_descriptor(), file_descriptor, offset < 0 ? nullptr : &offset, count);
+	}
+
+	// Data left in the pipe by another transfer is not sent.
+	if (this->_piped_count > 0 && (this->_piped_file != file_descriptor || this->_piped_offset != offset))
+	{
+		this->close_pipe();
+	}
+
+	if (this->_pipe[0] < 0 && ::pipe2(this->_pipe, O_CLOEXEC | O_NONBLOCK) < 0)
+	{
+		throw SocketError(errno, "'pipe2' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
+	}
+
+	if (this->_piped_count == 0)
+	{
+		// Pipes and sockets may have no data yet, the thread should not
+		// block on them.
+		auto piped_count = ::splice(
+			file_descriptor, offset < 0 ? nullptr : &offset, this->_pipe[1], nullptr,
+			std::min(count, PIPE_SIZE), SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+		);
+		if (piped_count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// The pipe is empty, so the source is not ready.
+			errno = ENODATA;
+		}
+
+		if (piped_count <= 0)
+		{
+			return piped_count;
+		}
+
+		this->_piped_count = piped_count;
+		this->_piped_file = file_descriptor;
+		this->_piped_offset = offset < 0 ? offset : offset - piped_count;
+	}
+
+	auto result = ::splice(
+		this->_pipe[0], nullptr, this->file_descriptor(), nullptr,
+		this->_piped_count, SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+	);
+	if (result > 0)
+	{
+		this->_piped_count -= result;
+		if (this->_piped_offset >= 0)
+		{
+			this->_piped_offset += result;
+		}
+	}
+
+	return result;
+#else
+	// The file is copied through user space. The position of a file
+	// without offsets, e.g. a pipe, can not be moved back, so the part of
+	// a chunk which the socket does not accept is queued and sent before
+	// the next one.
+	if (!this->_pending_writes.empty())
+	{
+		this->send_queued(nullptr, 0, false);
+		if (!this->_pending_writes.empty())
+		{
+			errno = EAGAIN;
+			return -1;
+		}
+	}
+
+	char buffer[16384];
+	auto read_count = offset < 0 ?
+		::read(file_descriptor, buffer, std::min(count, sizeof(buffer))) :
+		::pread(file_descriptor, buffer, std::min(count, sizeof(buffer)), offset);
+	if (read_count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		errno = ENODATA;
+	}
+
+	if (read_count <= 0)
+	{
+		return read_count;
+	}
+
+	auto sent_count = ::send(this->file_descriptor(), buffer, read_count, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (sent_count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+		return sent_count;
+	}
+
+	sent_count = std::max(sent_count, (ssize_t)0);
+	this->_pending_writes.append(buffer + sent_count, read_count - sent_count);
+	return read_count;
+#endif
+}
+
+bool SocketIO::flush_before_file(bool wait)
+{
+	if (this->_ring)
+	{
+		if (!this->_write_queue.empty())
+		{
+			this->submit_to_ring(0);
+		}
+
+		return true;
+	}
+
+	if (!this->_pending_writes.empty())
+	{
+		this->send_queued(nullptr, 0, wait);
+	}
+
+	return this->_pending_writes.empty();
+}
+
+void SocketIO::close_pipe()
+{
+	if (this->_pipe[0] >= 0)
+	{
+		::close(this->_pipe[0]);
+		::close(this->_pipe[1]);
+		this->_pipe[0] = -1;
+		this->_pipe[1] = -1;
+	}
+
+	this->_piped_count = 0;
+}
+
+int SocketIO::shutdown(int how) const
+{
+	return ::shutdown(this->file_descriptor(), how);
+}
+
+bool SocketIO::read_available()
+{
+	auto bytes_count = net::DEFAULT_BUFFER_SIZE;
+	ssize_t len;
+	do
+	{
+		len = this->receive(bytes_count);
+	}
+	while (len < 0 && errno == EINTR);
+	if (len > 0)
+	{
+		return true;
+	}
+	else if (len == 0)
+	{
+		// EOF
+		return false;
+	}
+
+	auto error_code = errno;
+	switch (error_code)
+	{
+		case EAGAIN:
+			return true;
+		case ECONNRESET:
+			throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+		case ENOTCONN:
+			throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+		default:
+			throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
+	}
+}
+
+bool SocketIO::receive_available()
+{
+	if (this->_ring)
+	{
+		return this->submit_to_ring(net::DEFAULT_BUFFER_SIZE, -1, false);
+	}
+
+	return this->read_available();
+}
+
+ssize_t SocketIO::try_read(std::span<char> destination)
+{
+	destination = destination.first(this->readable_count(destination.size()));
+	if (destination.empty())
+	{
+		return 0;
+	}
+	else if (!this->buffer_is_empty())
+	{
+		auto count = std::min(destination.size(), this->_buffer.size());
+		std::memcpy(destination.data(), this->_buffer.data(), count);
+		this->consume(count);
+		return (ssize_t)count;
+	}
+
+	ssize_t len;
+	do
+	{
+		len = this->receive(destination.size(), destination.data());
+	}
+	while (len < 0 && errno == EINTR);
+	if (len >= 0)
+	{
+		this->count_read_bytes(len);
+		return len;
+	}
+
+	auto error_code = errno;
+	switch (error_code)
+	{
+		case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+		case EWOULDBLOCK:
+#endif
+			return -1;
+		case ECONNRESET:
+			throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+		case ENOTCONN:
+			throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+		default:
+			throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
+	}
+}
+
+ssize_t SocketIO::try_write(const char* data, size_t count)
+{
+	if (this->_ring)
+	{
+		return this->write(data, count);
+	}
+
+	if (!this->_pending_writes.empty())
+	{
+		return this->send_queued(data, count, false);
+	}
+
+	ssize_t bytes_sent_count;
+	do
+	{
+		bytes_sent_count = ::send(this->file_descriptor(), data, count, MSG_NOSIGNAL | MSG_DONTWAIT);
+	}
+	while (bytes_sent_count < 0 && errno == EINTR);
+	if (bytes_sent_count >= 0)
+	{
+		return bytes_sent_count;
+	}
+
+	auto error_code = errno;
+	switch (error_code)
+	{
+		case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+		case EWOULDBLOCK:
+#endif
+			return 0;
+		case ECONNRESET:
+			throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+		case ENOTCONN:
+			throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+		default:
+			throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
+	}
+}
+
+bool SocketIO::has_request_head() const
+{
+	// The buffer begins with the rest of the body.
+	if (this->_limit > 0)
+	{
+		return false;
+	}
+
+	return this->_head_parser.parse(this->_buffer.view()) != ParseStatus::NeedMore;
+}
+
+bool SocketIO::wait_for_data()
+{
+	return !this->buffer_is_empty() || this->read_bytes(net::DEFAULT_BUFFER_SIZE) > 0;
+}
+
+bool SocketIO::has_buffered_line(size_t max_count) const
+{
+	auto buffer = this->readable_view();
+	if (buffer.size() >= this->readable_count(max_count))
+	{
+		return true;
+	}
+
+	return util::find_line_end(buffer.data(), buffer.data() + buffer.size()) != nullptr;
+}
+
+ParseStatus SocketIO::read_head(std::string_view& head, IncrementalRequestParser& parser)
+{
+	// The previous head is not referenced anymore.
+	this->_buffer.unpin();
+	auto status = this->_head_parser.parse(this->_buffer.view());
+	while (status == ParseStatus::NeedMore && this->read_bytes(net::DEFAULT_BUFFER_SIZE) > 0)
+	{
+		status = this->_head_parser.parse(this->_buffer.view());
+	}
+
+	auto count = status == ParseStatus::Complete ? this->_head_parser.head_size() : this->_buffer.size();
+	head = this->_buffer.view().substr(0, count);
+	std::swap(this->_head_parser, parser);
+
+	// The read cursor is moved, the head stays while the body is read.
+	this->_buffer.pin(count);
+	this->consume(count);
+	return status;
+}
+
+bool SocketIO::receive_request_head()
+{
+	if (this->has_request_head())
+	{
+		return true;
+	}
+
+	try
+	{
+		auto buffered_count = this->_buffer.size();
+		while (this->receive_available() && this->_buffer.size() > buffered_count)
+		{
+			if (this->has_request_head())
+			{
+				return true;
+			}
+
+			buffered_count = this->_buffer.size();
+		}
+	}
+	catch (const SocketError&)
+	{
+	}
+
+	return false;
+}
+
+void SocketIO::set_options(const SocketOptions& options)
+{
+	auto socket = this->file_descriptor();
+	int value = options.no_delay;
+	::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+	if (options.keep_alive_idle_seconds > 0)
+	{
+		value = 1;
+		::setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(value));
+#if defined(__linux__)
+		::setsockopt(
+			socket, IPPROTO_TCP, TCP_KEEPIDLE, &options.keep_alive_idle_seconds, sizeof(options.keep_alive_idle_seconds)
+		);
+		if (options.keep_alive_interval_seconds > 0)
+		{
+			::setsockopt(
+				socket, IPPROTO_TCP, TCP_KEEPINTVL,
+				&options.keep_alive_interval_seconds, sizeof(options.keep_alive_interval_seconds)
+			);
+		}
+
+		if (options.keep_alive_probes_count > 0)
+		{
+			::setsockopt(
+				socket, IPPROTO_TCP, TCP_KEEPCNT, &options.keep_alive_probes_count, sizeof(options.keep_alive_probes_count)
+			);
+		}
+#endif
+	}
+
+#if defined(__linux__)
+	// The ring sends a response by a single operation anyway.
+	value = 0;
+	socklen_t length = sizeof(value);
+	this->_cork_responses = options.cork_responses && !this->_ring &&
+		::getsockopt(socket, IPPROTO_TCP, TCP_CORK, &value, &length) == 0;
+	value = 1;
+	this->_quick_ack = options.quick_ack &&
+		::setsockopt(socket, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value)) == 0;
+#endif
+}
+
+bool SocketIO::set_zero_copy_threshold(size_t threshold)
+{
+	this->_zero_copy_threshold = 0;
+	if (threshold == 0)
+	{
+		return true;
+	}
+
+#if defined(__linux__)
+	int is_enabled = 1;
+	if (!this->_ring && ::setsockopt(this->file_descriptor(), SOL_SOCKET, SO_ZEROCOPY, &is_enabled, sizeof(is_enabled)) == 0)
+	{
+		this->_zero_copy_threshold = threshold;
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+void SocketIO::release_buffer()
+{
+	if (this->_buffer.empty())
+	{
+		this->_buffer.release();
+		this->_head_parser.reset();
+		this->_receive_size = MIN_RECEIVE_SIZE;
+	}
+}
+
+ssize_t SocketIO::append_from_buffer_to(std::string& buffer, size_t max_count, bool erase)
+{
+	auto count = (max_count < this->buffered()) ? max_count : this->buffered();
+	buffer.append(this->_buffer.data(), count);
+	if (erase)
+	{
+		this->consume(count);
+	}
+
+	return (ssize_t)count;
+}
+
+ssize_t SocketIO::read_bytes(size_t max_count, char* destination)
+{
+	// The peer may wait for queued data, e.g. for "100 Continue".
+	this->flush();
+
+	bool try_again;
+
+	// Try to read first, data is often already available, so the
+	// selector is called only if the socket is not ready yet.
+	bool wait_for_data = false;
+	do
+	{
+		auto bytes_count = max_count;
+
+		// Reads to the caller's memory are not limited by the buffer.
+		if (!destination)
+		{
+			bytes_count = std::min(net::DEFAULT_BUFFER_SIZE, bytes_count);
+		}
+
+		if (bytes_count == 0)
+		{
+			throw EoF("end of socket stream", _ERROR_DETAILS_);
+		}
+
+		if (this->_ring)
+		{
+			auto buffered_count = this->_buffer.size();
+			return this->submit_to_ring(bytes_count) ? (ssize_t)(this->_buffer.size() - buffered_count) : 0;
+		}
+
+		try_again = false;
+		if (wait_for_data)
+		{
+			auto timeout = this->wait_timeout(this->_read_deadline);
+			if (!this->_selector->select(timeout.tv_sec, timeout.tv_usec))
+			{
+				throw SocketError(ETIMEDOUT, "Connection timed out", _ERROR_DETAILS_);
+			}
+		}
+
+		auto len = this->receive(bytes_count, destination);
+		if (len >= 0)
+		{
+			// Zero at EOF.
+			return len;
+		}
+		else if (len < 0)
+		{
+			auto error_code = errno;
+			switch (error_code)
+			{
+				case EINTR:
+					try_again = true;
+					break;
+				case ETIMEDOUT:
+				case EAGAIN:
+					wait_for_data = true;
+					try_again = true;
+					break;
+				case ECONNRESET:
+					throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+				case ENOTCONN:
+					throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+				default:
+					throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
+			}
+		}
+	}
+	while (try_again);
+	return 0;
+}
+
+ssize_t SocketIO::receive(size_t max_count, char* destination)
+{
+	if (destination)
+	{
+		return ::recv(this->file_descriptor(), destination, max_count, MSG_DONTWAIT);
+	}
+
+	auto bytes_count = std::min(max_count, this->_receive_size);
+	auto len = ::recv(this->file_descriptor(), this->_buffer.prepare(bytes_count), bytes_count, MSG_DONTWAIT);
+	if (len > 0)
+	{
+#if defined(__linux__)
+		if (this->_quick_ack)
+		{
+			int is_enabled = 1;
+			::setsockopt(this->file_descriptor(), IPPROTO_TCP, TCP_QUICKACK, &is_enabled, sizeof(is_enabled));
+		}
+#endif
+
+		this->_buffer.commit(len);
+
+		if ((size_t)len == this->_receive_size && this->_receive_size < net::DEFAULT_BUFFER_SIZE)
+		{
+			this->_receive_size *= 2;
+		}
+	}
+
+	return len;
+}
+
+timeval SocketIO::wait_timeout(std::chrono::steady_clock::time_point deadline) const
+{
+	if (deadline == std::chrono::steady_clock::time_point::max())
+	{
+		return this->_timeout;
+	}
+
+	auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+	if (left <= std::chrono::microseconds::zero())
+	{
+		throw SocketError(ETIMEDOUT, "Connection timed out", _ERROR_DETAILS_);
+	}
+
+	auto timeout = std::chrono::seconds(this->_timeout.tv_sec) + std::chrono::microseconds(this->_timeout.tv_usec);
+	if (left >= timeout)
+	{
+		return this->_timeout;
+	}
+
+	return {
+		.tv_sec = (time_t)(left.count() / 1000000),
+		.tv_usec = (suseconds_t)(left.count() % 1000000)
+	};
+}
+
+bool SocketIO::submit_to_ring(size_t receive_count, int shutdown_how, bool wait)
+{
+#if defined(__linux__)
+	auto socket = this->file_descriptor();
+
+	// Checked before anything is queued, the timeout is linked to the
+	// receive operation only.
+	auto wait_timeout = receive_count > 0 ? this->wait_timeout(this->_read_deadline) : this->_timeout;
+
+	// Operations are linked, so the kernel performs them in order and
+	// cancels the rest of the chain on failure.
+	if (!this->_write_queue.empty())
+	{
+		bool link = receive_count > 0 || shutdown_how >= 0;
+		this->_ring->prepare_send(
+			socket, this->_write_queue.data(), this->_write_queue.size(), RingOperation::Send, link
+		);
+		this->_queued_operations_count++;
+	}
+
+	if (shutdown_how >= 0)
+	{
+		this->_ring->prepare_shutdown(socket, shutdown_how, RingOperation::Shutdown, false);
+		this->_queued_operations_count++;
+	}
+
+	__kernel_timespec timeout{
+		.tv_sec = wait_timeout.tv_sec,
+		.tv_nsec = wait_timeout.tv_usec * 1000
+	};
+	if (receive_count > 0 && !wait)
+	{
+		this->_ring->prepare_recv(socket, receive_count, RingOperation::Receive, false, MSG_DONTWAIT);
+		this->_queued_operations_count++;
+	}
+	else if (receive_count > 0)
+	{
+		this->_ring->prepare_recv(socket, receive_count, RingOperation::Receive, true);
+		this->_ring->prepare_link_timeout(&timeout, RingOperation::Timeout);
+		this->_queued_operations_count += 2;
+	}
+
+	// All completions must be reaped before returning, because the ring
+	// is shared by streams of the current thread.
+	int error_code = 0;
+	bool is_received = false;
+	bool is_timed_out = false;
+	while (this->_queued_operations_count > 0)
+	{
+		auto* cqe = this->_ring->peek_cqe();
+		if (!cqe)
+		{
+			auto result = this->_ring->submit(1);
+			if (result < 0)
+			{
+				throw SocketError(
+					-result, "'io_uring_enter' call failed: " + std::to_string(-result), _ERROR_DETAILS_
+				);
+			}
+
+			continue;
+		}
+
+		auto operation = cqe->user_data;
+		auto result = cqe->res;
+		auto flags = cqe->flags;
+		this->_ring->cqe_seen();
+		if (operation == 0)
+		{
+			continue;
+		}
+
+		this->_queued_operations_count--;
+		switch (operation)
+		{
+			case RingOperation::Receive:
+				if (flags & IORING_CQE_F_BUFFER)
+				{
+					if (result > 0)
+					{
+						this->_buffer.append(this->_ring->selected_buffer(flags), result);
+
+						is_received = true;
+					}
+
+					this->_ring->recycle_buffer(flags);
+				}
+				else if (result == -ECANCELED)
+				{
+					is_timed_out = true;
+				}
+				else if (result < 0 && result != -EAGAIN && error_code == 0)
+				{
+					error_code = -result;
+				}
+				break;
+			case RingOperation::Send:
+				if (result >= 0 && result < (int)this->_write_queue.size())
+				{
+					result = -EIO;
+				}
+
+				[[fallthrough]];
+			case RingOperation::Shutdown:
+				if (result < 0 && result != -ECANCELED && error_code == 0)
+				{
+					error_code = -result;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	this->_write_queue.clear();
+	switch (error_code)
+	{
+		case 0:
+			break;
+		case ECONNRESET:
+		case EPIPE:
+			throw SocketError(error_code, "Connection reset by peer", _ERROR_DETAILS_);
+		case ENOTCONN:
+			throw SocketError(error_code, "Transport endpoint is not connected", _ERROR_DETAILS_);
+		default:
+			throw SocketError(error_code, "Connection filed", _ERROR_DETAILS_);
+	}
+
+	if (is_timed_out)
+	{
+		throw SocketError(ETIMEDOUT, "Connection timed out", _ERROR_DETAILS_);
+	}
+
+	return is_received;
+#else
+	throw SocketError(ENOSYS, "io_uring is not supported by the system", _ERROR_DETAILS_);
+#endif
+}
+
+ssize_t read_into(io::ILimitedBufferedStream* reader, std::span<char> destination)
+{
+	require_non_null(reader, "'reader' is nullptr", _ERROR_DETAILS_);
+	if (auto* socket_io = dynamic_cast<SocketIO*>(reader))
+	{
+		return socket_io->read(destination);
+	}
+
+	if (auto* chunked_body = dynamic_cast<ChunkedBodyReader*>(reader))
+	{
+		return chunked_body->read(destination);
+	}
+
+	std::string buffer;
+	auto count = reader->read(buffer, destination.size());
+	if (count > 0)
+	{
+		std::memcpy(destination.data(), buffer.data(), count);
+	}
+
+	return count;
+}
+
+void flush_writes(io::ILimitedBufferedStream* writer)
+{
+	require_non_null(writer, "'writer' is nullptr", _ERROR_DETAILS_);
+	if (auto* socket_io = dynamic_cast<SocketIO*>(writer))
+	{
+		socket_io->flush();
+	}
+}
+
+ssize_t send_file(io::ILimitedBufferedStream* writer, int file_descriptor, off_t offset, size_t count)
+{
+	require_non_null(writer, "'writer' is nullptr", _ERROR_DETAILS_);
+	if (auto* socket_io = dynamic_cast<SocketIO*>(writer))
+	{
+		return socket_io->send_file(file_descriptor, offset, count);
+	}
+
+	char buffer[16384];
+	size_t bytes_sent_count = 0;
+	while (bytes_sent_count < count)
+	{
+		auto read_count = offset < 0 ?
+			::read(file_descriptor, buffer, std::min(count - bytes_sent_count, sizeof(buffer))) :
+			::pread(
+				file_descriptor, buffer, std::min(count - bytes_sent_count, sizeof(buffer)),
+				offset + (off_t)bytes_sent_count
+			);
+		if (read_count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (read_count < 0)
+		{
+			throw FileError("'read' call failed: " + std::to_string(errno), _ERROR_DETAILS_);
+		}
+		else if (read_count == 0)
+		{
+			break;
+		}
+
+		// The read part can not be read again from files without
+		// offsets, so it is written whole.
+		ssize_t written_count = 0;
+		while (written_count < read_count)
+		{
+			auto result = writer->write(buffer + written_count, read_count - written_count);
+			if (result <= 0)
+			{
+				throw FileError(
+					"failed to write " + std::to_string(read_count - written_count) + " bytes of the file",
+					_ERROR_DETAILS_
+				);
+			}
+
+			written_count += result;
+		}
+
+		bytes_sent_count += read_count;
+	}
+
+	return (ssize_t)bytes_sent_count;
 }
 
 __SERVER_END__
@@ -9,9 +9,15 @@
 #pragma once
 
 // C++ libraries.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <span>
+#include <string_view>
 #include <sys/select.h>
+#include <sys/types.h>
 
 // Base libraries.
 #include <xalwart.base/io.h>
@@ -21,39 +27,156 @@
 
 // Server libraries.
 #include "../interfaces.h"
+#include "../request_parser.h"
+#include "../slab_pool.h"
+#include "./read_buffer.h"
+#include "./write_queue.h"
 
 
 __SERVER_BEGIN__
 
+class IOUring;
+
 // TODO: docs for 'SocketIO'
 class SocketIO final : public io::ILimitedBufferedStream
 {
 public:
 	explicit SocketIO(int fd, timeval timeout, std::unique_ptr<ISelector> selector);
 
+	// Performs I/O through 'ring' which should be owned by the calling
+	// thread. Written data is queued and submitted together with the
+	// next read or with 'close_writer', so a response and the shutdown
+	// of the connection cost a single system call.
+	explicit SocketIO(int fd, timeval timeout, IOUring* ring);
+
+	~SocketIO() override;
+
 	SocketIO& operator= (SocketIO&& other) noexcept;
 
+	// Streams are created for each connection.
+	static inline void* operator new(size_t size)
+	{
+		return SlabPool::allocate(size);
+	}
+
+	static inline void operator delete(void* pointer, size_t size) noexcept
+	{
+		SlabPool::deallocate(pointer, size);
+	}
+
 	ssize_t read_line(std::string& line) override;
 
+	// Reads a line including '\n' without copying it. 'line' points to
+	// the buffer and is valid until the next read. The rest of the data
+	// is returned as a line at EOF.
+	//
+	// At most 'max_count' bytes are read, so the line does not end with
+	// '\n' if it is longer.
+	ssize_t read_line(std::string_view& line, size_t max_count=SIZE_MAX);
+
 	ssize_t read(std::string& buffer, size_t max_count) override;
 
+	// Reads up to 'destination.size()' bytes to 'destination'. Buffered
+	// data is copied, otherwise large reads receive data from the socket
+	// directly to 'destination'. Returns zero at EOF.
+	ssize_t read(std::span<char> destination);
+
+	// Reads up to 'max_count' bytes without copying them. 'data' points
+	// to the buffer and is valid until the next read. Returns zero at
+	// EOF.
+	ssize_t read(std::string_view& data, size_t max_count);
+
 	ssize_t peek(std::string& buffer, size_t max_count) override;
 
+	// Queued data is sent before 'data' by the same system call. With
+	// a write buffer, shorter writes are queued, see
+	// 'set_write_buffer_size'.
 	ssize_t write(const char* data, size_t count) override;
 
+	// Writes shorter than 'size' bytes are queued until the queue
+	// reaches 'size' bytes, 'flush' is called or the request is
+	// finished, so a response written by many small pieces is sent by
+	// a few system calls. Zero sends each write immediately.
+	//
+	// Not used with a ring, it queues all writes.
+	inline void set_write_buffer_size(size_t size)
+	{
+		this->_write_buffer_size = size;
+	}
+
+	// Set while the request which is handled is followed by received
+	// ones: writes are buffered by at least 'PIPELINED_WRITES_SIZE'
+	// bytes, so responses to pipelined requests are sent together.
+	inline void set_pipelined(bool is_pipelined)
+	{
+		this->_is_pipelined = is_pipelined;
+	}
+
+	// Queues 'data' if it is shorter than the write buffer. Returns
+	// false if it should be written.
+	bool buffer(const char* data, size_t count);
+
+	[[nodiscard]]
+	inline bool write_buffer_is_full() const
+	{
+		auto size = this->write_buffer_size();
+		return size > 0 && this->_pending_writes.size() >= size;
+	}
+
+	[[nodiscard]]
+	inline bool has_pending_writes() const
+	{
+		return !this->_pending_writes.empty();
+	}
+
+	// Queues 'data' to be sent together with the next write, 'flush' or
+	// read, so a response head, its body and trailers are sent by a
+	// single 'sendmsg'. With a ring data is queued as by 'write'.
+	void queue(const char* data, size_t count);
+
+	void queue(std::string data);
+
+	// 'data' is not copied and should be valid until it is sent.
+	void queue_reference(const char* data, size_t count);
+
+	// Sends queued data and releases the cork of the response. With a
+	// ring data is submitted with the next read or with 'close_writer'.
+	void flush();
+
+	// Sends 'count' bytes of the file from 'offset' after queued data
+	// without copying them to user space: by 'sendfile' for regular
+	// files and by 'splice' through a pipe for others. Negative 'offset'
+	// means the current position, it is required for pipes and sockets.
+	//
+	// Returns the count of sent bytes, less than 'count' at the end of
+	// the file.
+	ssize_t send_file(int file_descriptor, off_t offset, size_t count);
+
+	// Sends as much of the file as the socket accepts without blocking.
+	// Returns zero at the end of the file and -1 if nothing is sent:
+	// 'errno' is 'EAGAIN' if the socket buffer is full and 'ENODATA' if
+	// the file, e.g. a pipe, has no data yet. Without 'sendfile' and
+	// 'splice' the sent count includes bytes which are queued for the
+	// next write or 'flush'.
+	ssize_t try_send_file(int file_descriptor, off_t offset, size_t count);
+
+	// Data which the reader may take without waiting, see 'set_limit'.
 	[[nodiscard]]
 	inline ssize_t buffered() const override
 	{
-		return (ssize_t)this->_buffer.size();
+		return (ssize_t)this->readable_count(this->_buffer.size());
 	}
 
 	bool close_reader() override;
 
 	bool close_writer() override;
 
+	// Reads return at most 'limit' bytes in total, then zero as at EOF,
+	// e.g. the body of the request, so data which follows it is kept in
+	// the buffer for the next request. Negative 'limit' removes it.
 	inline void set_limit(ssize_t limit) override
 	{
-		this->_limit = limit - (ssize_t)this->_buffer.size();
+		this->_limit = limit;
 	}
 
 	[[nodiscard]]
@@ -65,22 +188,187 @@ public:
 	[[nodiscard]]
 	int shutdown(int how) const;
 
-protected:
+	// Appends data which is already available in the socket to the
+	// buffer without blocking. Returns false on EOF.
+	//
+	// Used by event loops, the ring is not involved.
+	bool read_available();
+
+	// Reads to 'destination' without blocking as 'read' does. Returns
+	// zero at EOF and -1 if no data is available.
+	//
+	// Used by event loops, the ring is not involved.
+	ssize_t try_read(std::span<char> destination);
+
+	// Checks if the buffer contains the whole request line and headers
+	// or a malformed part of them, i.e. the request can be handled
+	// without waiting for the socket. Received lines are parsed once.
+	// False while the body of the current request is left before the
+	// limit, see 'set_limit'.
+	[[nodiscard]]
+	bool has_request_head() const;
+
+	// Limits of request heads, the defaults of 'Context' are used if it
+	// is not called.
+	inline void set_head_limits(size_t max_line_length, size_t max_headers_count)
+	{
+		this->_head_parser.set_limits(max_line_length, max_headers_count);
+	}
+
+	// Blocks until the buffer contains data. Returns false at EOF.
+	bool wait_for_data();
+
+	// Checks if 'read_line' with 'max_count' returns without waiting
+	// for the socket, i.e. the buffer contains '\n' or 'max_count' bytes
+	// before the limit.
+	[[nodiscard]]
+	bool has_buffered_line(size_t max_count) const;
+
+	// Reads and parses the head of a request up to and including the
+	// empty line which ends it without copying. 'head' is pinned in the
+	// buffer, so it stays valid while the body is read, until the next
+	// call or 'release_buffer'.
+	//
+	// The parser of the socket, which holds the result, is swapped with
+	// 'parser'. Returns its status: 'ParseStatus::NeedMore' if the
+	// connection is closed before the head is complete, then 'head' is
+	// what is received.
+	ParseStatus read_head(std::string_view& head, IncrementalRequestParser& parser);
+
+	// Checks if the buffer contains the whole head of a request after
+	// appending data which is already available in the socket, so
+	// pipelined requests are found without an event loop. Errors are
+	// left to the next read.
+	bool receive_request_head();
+
+	// Applies options of accepted connections. Options which are not
+	// supported by the socket are skipped.
+	void set_options(const SocketOptions& options);
+
+	// Blocking writes of at least 'threshold' bytes are sent with
+	// 'MSG_ZEROCOPY': the kernel transmits pages of the data instead of
+	// copying them and the write returns after the kernel releases
+	// them. Queued buffers are sent before such data by regular writes.
+	// Zero disables it. Returns false if the socket does not support it.
+	//
+	// Linux only, not used with a ring.
+	bool set_zero_copy_threshold(size_t threshold);
+
+	// Returns the memory of the buffer to the pool if it has no unread
+	// data, so idle connections do not hold buffers.
+	void release_buffer();
+
+	// Sends as much of 'data' as the socket accepts without blocking.
+	// Returns the count of sent bytes, zero if the socket buffer is
+	// full. Queued data is sent first. With a ring data is queued as by
+	// 'write'.
+	ssize_t try_write(const char* data, size_t count);
+
 	[[nodiscard]]
 	inline int file_descriptor() const
 	{
 		return this->_file_descriptor;
 	}
 
+	[[nodiscard]]
+	inline timeval timeout() const
+	{
+		return this->_timeout;
+	}
+
+	// Blocking reads and writes fail with 'ETIMEDOUT' after the
+	// deadline, a single wait is shortened to it. Set by the request
+	// handler for each stage of the request.
+	inline void set_deadlines(
+		std::chrono::steady_clock::time_point read_deadline,
+		std::chrono::steady_clock::time_point write_deadline
+	)
+	{
+		this->_read_deadline = read_deadline;
+		this->_write_deadline = write_deadline;
+	}
+
+protected:
 	ssize_t append_from_buffer_to(std::string& buffer, size_t max_count, bool erase=true);
 
-	bool read_bytes(size_t max_count);
+	inline void consume(size_t count)
+	{
+		this->_buffer.consume(count);
+		this->count_read_bytes(count);
+
+		// The head is parsed from the read cursor.
+		this->_head_parser.reset();
+	}
+
+	// Blocks until data is received to the buffer or to 'destination' if
+	// it is set, the ring always uses the buffer. Returns the count of
+	// received bytes, zero at EOF.
+	ssize_t read_bytes(size_t max_count, char* destination=nullptr);
+
+	// Returns the time left for a single wait before 'deadline'. Throws
+	// 'SocketError' if the deadline is passed.
+	[[nodiscard]]
+	timeval wait_timeout(std::chrono::steady_clock::time_point deadline) const;
+
+	// Blocks until the socket is writable or the timeout expires.
+	void wait_for_write() const;
+
+	// Blocks until the file which is sent has data or the write timeout
+	// expires.
+	void wait_for_source(int file_descriptor) const;
+
+	// Polls 'file_descriptor' for 'events' within the write timeout,
+	// interrupted polls continue with the time which is left. Returns
+	// the received events. Throws 'SocketError' with 'ETIMEDOUT' if the
+	// timeout expires and with the error of 'poll' if it fails.
+	short wait_for(int file_descriptor, short events) const;
+
+	// Holds partial segments until 'flush' if responses are corked.
+	void cork();
+
+	// Receives notifications of released zero-copy sends from the error
+	// queue of the socket. Blocks until all of them are received if
+	// 'wait' is set.
+	void reap_zero_copy_completions(bool wait);
+
+	// Performs a single transfer of the file. Returns the result of the
+	// system call, which sets 'errno' on failure: 'EAGAIN' if the socket
+	// buffer is full and 'ENODATA' if the file has no data yet.
+	ssize_t send_file_part(int file_descriptor, off_t offset, size_t count, bool is_regular_file);
+
+	// Sends queued data of the ring or the stream, blocks if 'wait' is
+	// set. Returns true if nothing is left.
+	bool flush_before_file(bool wait);
+
+	// Sends queued data followed by 'data' using vectored writes, which
+	// are repeated after partial ones. Without 'wait' returns when the
+	// socket buffer is full. Returns the count of sent bytes of 'data'.
+	ssize_t send_queued(const char* data, size_t count, bool wait);
+
+	// Submits queued writes linked with either receive operation of
+	// up to 'receive_count' bytes or shutdown of the socket in 'how'
+	// direction, and waits for completion of all operations. Without
+	// 'wait' the receive takes only data which is already available, as
+	// 'read_available' does.
+	//
+	// Returns false on EOF or if nothing is received without 'wait'.
+	bool submit_to_ring(size_t receive_count, int shutdown_how=-1, bool wait=true);
+
+	// Appends data which is already available in the socket to the
+	// buffer through the ring if it is used. Returns false on EOF, and
+	// through the ring also if nothing is available.
+	bool receive_available();
 
 	inline void clear_buffer()
 	{
 		this->_buffer.clear();
+		this->_head_parser.reset();
 	}
 
+	// Receives up to 'max_count' bytes into the buffer or 'destination'
+	// without blocking. Returns the result of 'recv'.
+	ssize_t receive(size_t max_count, char* destination=nullptr);
+
 	[[nodiscard]]
 	inline bool buffer_is_empty() const
 	{
@@ -99,12 +387,113 @@ protected:
 		return this->limit() >= 0;
 	}
 
+	// Returns up to 'max_count' bytes which are left before the limit.
+	[[nodiscard]]
+	inline size_t readable_count(size_t max_count) const
+	{
+		return this->has_limit() ? std::min(max_count, (size_t)this->_limit) : max_count;
+	}
+
+	// Buffered data which is left before the limit.
+	[[nodiscard]]
+	inline std::string_view readable_view() const
+	{
+		auto view = this->_buffer.view();
+		return view.substr(0, this->readable_count(view.size()));
+	}
+
+	// Reduces the limit by bytes which are passed to the reader.
+	inline void count_read_bytes(size_t count)
+	{
+		if (this->has_limit())
+		{
+			this->_limit -= (ssize_t)std::min(count, (size_t)this->_limit);
+		}
+	}
+
 private:
 	Socket _file_descriptor;
 	timeval _timeout;
+	std::chrono::steady_clock::time_point _read_deadline;
+	std::chrono::steady_clock::time_point _write_deadline;
 	std::unique_ptr<ISelector> _selector;
-	std::string _buffer;
+	ReadBuffer _buffer;
 	ssize_t _limit;
+
+	// Parses the head from the read cursor while parts of it are
+	// received.
+	mutable IncrementalRequestParser _head_parser;
+
+	// Size of a single receive, doubled while the socket fills it, so
+	// idle connections keep small buffers.
+	size_t _receive_size;
+
+	static constexpr size_t MIN_RECEIVE_SIZE = 4096;
+
+	// Data queued by 'queue' when there is no ring.
+	WriteQueue _pending_writes;
+
+	// Vectors of a single 'sendmsg'.
+	static constexpr size_t MAX_WRITE_VECTORS = 64;
+
+	// Set by 'set_options'.
+	bool _cork_responses;
+	bool _is_corked;
+	bool _quick_ack;
+
+	// Set by 'set_write_buffer_size' and 'set_pipelined'.
+	size_t _write_buffer_size;
+	bool _is_pipelined;
+
+	static constexpr size_t PIPELINED_WRITES_SIZE = 65536;
+
+	[[nodiscard]]
+	inline size_t write_buffer_size() const
+	{
+		return this->_is_pipelined ? std::max(this->_write_buffer_size, PIPELINED_WRITES_SIZE) : this->_write_buffer_size;
+	}
+
+	// The kernel numbers zero-copy sends of the socket, released ones
+	// are reported by ranges of the numbers.
+	size_t _zero_copy_threshold;
+	uint32_t _zero_copy_sent_count;
+	uint32_t _zero_copy_released_count;
+
+	// Pipe for 'splice' of files which are not regular, created by the
+	// first transfer. It holds '_piped_count' bytes of '_piped_file'
+	// from '_piped_offset' which are not sent yet.
+	int _pipe[2];
+	size_t _piped_count;
+	int _piped_file;
+	off_t _piped_offset;
+
+	static constexpr size_t PIPE_SIZE = 65536;
+
+	void close_pipe();
+
+	IOUring* _ring;
+	std::string _write_queue;
+	size_t _queued_operations_count;
+
+	// Queued writes are submitted immediately when exceeding this size.
+	static constexpr size_t MAX_WRITE_QUEUE_SIZE = 65536;
 };
 
+// TESTME: read_into
+// Reads up to 'destination.size()' bytes of 'reader' to 'destination',
+// without intermediate copies if it is 'SocketIO' or a chunked body of
+// it. Returns zero at EOF.
+extern ssize_t read_into(io::ILimitedBufferedStream* reader, std::span<char> destination);
+
+// TESTME: flush_writes
+// Sends data buffered by 'writer' if it is 'SocketIO', other streams
+// write immediately.
+extern void flush_writes(io::ILimitedBufferedStream* writer);
+
+// TESTME: send_file
+// Sends 'count' bytes of the file from 'offset' through 'writer'
+// without copying them to user space if it is 'SocketIO'. Other
+// writers receive the file by parts. Returns the count of sent bytes.
+extern ssize_t send_file(io::ILimitedBufferedStream* writer, int file_descriptor, off_t offset, size_t count);
+
 __SERVER_END__
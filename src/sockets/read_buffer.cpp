@@ -0,0 +1,117 @@
+/**
+ * sockets/read_buffer.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./read_buffer.h"
+
+// C++ libraries.
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// Server libraries.
+#include "../slab_pool.h"
+
+
+__SERVER_BEGIN__
+
+ReadBuffer::ReadBuffer(ReadBuffer&& other) noexcept :
+	_data(std::exchange(other._data, nullptr)),
+	_capacity(std::exchange(other._capacity, 0)),
+	_begin(std::exchange(other._begin, 0)),
+	_end(std::exchange(other._end, 0)),
+	_pinned(std::exchange(other._pinned, 0)),
+	_pinned_data(std::exchange(other._pinned_data, nullptr)),
+	_pinned_capacity(std::exchange(other._pinned_capacity, 0))
+{
+}
+
+ReadBuffer& ReadBuffer::operator= (ReadBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		this->release();
+		this->_data = std::exchange(other._data, nullptr);
+		this->_capacity = std::exchange(other._capacity, 0);
+		this->_begin = std::exchange(other._begin, 0);
+		this->_end = std::exchange(other._end, 0);
+		this->_pinned = std::exchange(other._pinned, 0);
+		this->_pinned_data = std::exchange(other._pinned_data, nullptr);
+		this->_pinned_capacity = std::exchange(other._pinned_capacity, 0);
+	}
+
+	return *this;
+}
+
+char* ReadBuffer::prepare(size_t count)
+{
+	if (this->_capacity - this->_end >= count)
+	{
+		return this->_data + this->_end;
+	}
+
+	auto size = this->size();
+	if (this->_capacity - this->_pinned - size >= count)
+	{
+		// Enough space when unread data is moved to the beginning.
+		std::memmove(this->_data + this->_pinned, this->data(), size);
+	}
+	else
+	{
+		auto capacity = SlabPool::block_size(std::max(this->_capacity * 2, size + count));
+		// Not initialized, it is overwritten by received data.
+		auto* data = (char*)SlabPool::allocate(capacity);
+		if (size > 0)
+		{
+			std::memcpy(data, this->data(), size);
+		}
+
+		if (this->_pinned > 0)
+		{
+			// The new block has no pinned data, so the old one is the
+			// only one kept.
+			this->_pinned_data = this->_data;
+			this->_pinned_capacity = this->_capacity;
+			this->_pinned = 0;
+		}
+		else
+		{
+			SlabPool::deallocate(this->_data, this->_capacity);
+		}
+
+		this->_data = data;
+		this->_capacity = capacity;
+	}
+
+	this->_begin = this->_pinned;
+	this->_end = this->_pinned + size;
+	return this->_data + this->_end;
+}
+
+void ReadBuffer::unpin()
+{
+	SlabPool::deallocate(this->_pinned_data, this->_pinned_capacity);
+	this->_pinned_data = nullptr;
+	this->_pinned_capacity = 0;
+	this->_pinned = 0;
+}
+
+void ReadBuffer::release()
+{
+	this->unpin();
+	SlabPool::deallocate(this->_data, this->_capacity);
+	this->_data = nullptr;
+	this->_capacity = 0;
+	this->_begin = 0;
+	this->_end = 0;
+}
+
+void ReadBuffer::append(const char* data, size_t count)
+{
+	std::memcpy(this->prepare(count), data, count);
+	this->commit(count);
+}
+
+__SERVER_END__
@@ -0,0 +1,132 @@
+/**
+ * sockets/read_buffer.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Growable buffer of received data with read and write cursors.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <string_view>
+
+// Module definitions.
+#include "../_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: ReadBuffer
+// Contiguous memory where the socket writes received data directly
+// after the write cursor and consumers advance the read cursor, so
+// consuming does not copy the rest of the data. Unread data is moved to
+// the beginning only when the free space at the end is not enough.
+//
+// Memory is allocated from 'SlabPool', so the capacity is rounded up to
+// the size of a block.
+//
+// Consumed data may be pinned, e.g. the head of a request which is
+// referenced while its body is read. Unread data is moved after the
+// pinned part then, or to a new block while the old one is kept.
+class ReadBuffer final
+{
+public:
+	ReadBuffer() = default;
+
+	ReadBuffer(ReadBuffer&& other) noexcept;
+
+	ReadBuffer& operator= (ReadBuffer&& other) noexcept;
+
+	inline ~ReadBuffer()
+	{
+		this->release();
+	}
+
+	[[nodiscard]]
+	inline size_t size() const
+	{
+		return this->_end - this->_begin;
+	}
+
+	[[nodiscard]]
+	inline bool empty() const
+	{
+		return this->_begin == this->_end;
+	}
+
+	[[nodiscard]]
+	inline const char* data() const
+	{
+		return this->_data + this->_begin;
+	}
+
+	// Unread data, invalidated by 'prepare' and 'append'.
+	[[nodiscard]]
+	inline std::string_view view() const
+	{
+		return {this->data(), this->size()};
+	}
+
+	// Returns the write cursor with at least 'count' bytes of free space
+	// after it. The data should be committed by 'commit'.
+	char* prepare(size_t count);
+
+	inline void commit(size_t count)
+	{
+		this->_end += count;
+	}
+
+	void append(const char* data, size_t count);
+
+	// Advances the read cursor by 'count' bytes.
+	inline void consume(size_t count)
+	{
+		this->_begin += count;
+		if (this->_begin >= this->_end)
+		{
+			this->clear();
+		}
+	}
+
+	inline void clear()
+	{
+		this->_begin = this->_pinned;
+		this->_end = this->_pinned;
+	}
+
+	// Keeps data up to 'count' bytes after the read cursor in place after
+	// it is consumed, until 'unpin'. Data pinned before is released.
+	inline void pin(size_t count)
+	{
+		this->unpin();
+		this->_pinned = this->_begin + count;
+	}
+
+	void unpin();
+
+	[[nodiscard]]
+	inline size_t capacity() const
+	{
+		return this->_capacity;
+	}
+
+	// Returns the memory to the pool, unread and pinned data is
+	// discarded.
+	void release();
+
+private:
+	char* _data = nullptr;
+	size_t _capacity = 0;
+	size_t _begin = 0;
+	size_t _end = 0;
+
+	// End of pinned data in '_data'.
+	size_t _pinned = 0;
+
+	// Block with pinned data which is replaced by a larger one.
+	char* _pinned_data = nullptr;
+	size_t _pinned_capacity = 0;
+};
+
+__SERVER_END__
@@ -17,11 +17,10 @@
 
 __SERVER_BEGIN__
 
-void TCPSocket::set_options()
+void TCPSocket::set_options(const SocketOptions& options)
 {
-//	int options = 1;
-//	setsockopt(this->socket, IPPROTO_TCP, TCP_NODELAY, &options, sizeof(options));
-	BaseSocket::set_options();
+	this->set_tcp_options(options);
+	BaseSocket::set_options(options);
 }
 
 void TCPSocket::bind()
@@ -18,11 +18,10 @@
 
 __SERVER_BEGIN__
 
-void TCP6Socket::set_options()
+void TCP6Socket::set_options(const SocketOptions& options)
 {
-	int options = 1;
-	setsockopt(this->socket, IPPROTO_TCP, TCP_NODELAY, &options, sizeof(options));
-	BaseSocket::set_options();
+	this->set_tcp_options(options);
+	BaseSocket::set_options(options);
 }
 
 void TCP6Socket::bind()
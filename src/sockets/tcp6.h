@@ -32,7 +32,7 @@ public:
 	{
 	}
 
-	void set_options() override;
+	void set_options(const SocketOptions& options={}) override;
 
 protected:
 	void bind() override;
@@ -0,0 +1,109 @@
+/**
+ * sockets/write_queue.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./write_queue.h"
+
+// C++ libraries.
+#include <algorithm>
+
+
+__SERVER_BEGIN__
+
+void WriteQueue::append(const char* data, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (this->_chunks.size() > this->_front)
+	{
+		auto& last = this->_chunks.back();
+		if (!last.reference && last.size + count <= MAX_MERGED_SIZE)
+		{
+			last.data.append(data, count);
+			last.size += count;
+			this->_size += count;
+			return;
+		}
+	}
+
+	this->append(std::string(data, count));
+}
+
+void WriteQueue::append(std::string data)
+{
+	if (data.empty())
+	{
+		return;
+	}
+
+	auto size = data.size();
+	this->_chunks.push_back(Chunk{.data = std::move(data), .reference = nullptr, .size = size});
+	this->_size += size;
+}
+
+void WriteQueue::append_reference(const char* data, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	this->_chunks.push_back(Chunk{.data = {}, .reference = data, .size = count});
+	this->_size += count;
+}
+
+size_t WriteQueue::prepare(iovec* vectors, size_t max_count) const
+{
+	size_t count = 0;
+	auto offset = this->_front_offset;
+	for (auto i = this->_front; i < this->_chunks.size() && count < max_count; i++)
+	{
+		const auto& chunk = this->_chunks[i];
+		auto* data = chunk.reference ? chunk.reference : chunk.data.data();
+		vectors[count++] = iovec{
+			.iov_base = (void*)(data + offset),
+			.iov_len = chunk.size - offset
+		};
+		offset = 0;
+	}
+
+	return count;
+}
+
+void WriteQueue::consume(size_t count)
+{
+	this->_size -= std::min(count, this->_size);
+	while (count > 0 && this->_front < this->_chunks.size())
+	{
+		auto left = this->_chunks[this->_front].size - this->_front_offset;
+		if (count < left)
+		{
+			this->_front_offset += count;
+			return;
+		}
+
+		count -= left;
+		this->_front++;
+		this->_front_offset = 0;
+	}
+
+	if (this->_size == 0)
+	{
+		this->clear();
+	}
+}
+
+void WriteQueue::clear()
+{
+	this->_chunks.clear();
+	this->_front = 0;
+	this->_front_offset = 0;
+	this->_size = 0;
+}
+
+__SERVER_END__
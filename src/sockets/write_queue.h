@@ -0,0 +1,81 @@
+/**
+ * sockets/write_queue.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Queue of buffers which are sent by a single vectored write.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+// Module definitions.
+#include "../_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: WriteQueue
+// Sequence of buffers, for example the head of a response, chunks of
+// its body and trailers. The buffers are either copied or referenced,
+// referenced ones should be valid until they are consumed. Small
+// copied buffers which follow each other are merged, so the count of
+// vectors stays low.
+class WriteQueue final
+{
+public:
+	[[nodiscard]]
+	inline size_t size() const
+	{
+		return this->_size;
+	}
+
+	[[nodiscard]]
+	inline bool empty() const
+	{
+		return this->_size == 0;
+	}
+
+	void append(const char* data, size_t count);
+
+	void append(std::string data);
+
+	void append_reference(const char* data, size_t count);
+
+	// Fills up to 'max_count' vectors with queued data from the front.
+	// Returns the count of filled vectors. The vectors are invalidated
+	// by appending to the queue.
+	size_t prepare(iovec* vectors, size_t max_count) const;
+
+	// Removes 'count' sent bytes from the front.
+	void consume(size_t count);
+
+	void clear();
+
+private:
+	struct Chunk
+	{
+		std::string data;
+
+		// Not owned data if not nullptr.
+		const char* reference;
+		size_t size;
+	};
+
+	std::vector<Chunk> _chunks;
+
+	// Index of the first not sent chunk and the count of sent bytes of
+	// it, so the front is removed without moving other chunks.
+	size_t _front = 0;
+	size_t _front_offset = 0;
+	size_t _size = 0;
+
+	// Copied buffers are merged up to this size.
+	static constexpr size_t MAX_MERGED_SIZE = 4096;
+};
+
+__SERVER_END__
@@ -0,0 +1,196 @@
+/**
+ * timer_wheel.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./timer_wheel.h"
+
+// C++ libraries.
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+
+__SERVER_BEGIN__
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, std::chrono::steady_clock::time_point start) :
+	_resolution(std::max(resolution, std::chrono::milliseconds(1))),
+	_start(start),
+	_current_tick(0),
+	_size(0),
+	_occupied{}
+{
+	for (auto& sentinel : this->_slots)
+	{
+		sentinel.previous = &sentinel;
+		sentinel.next = &sentinel;
+	}
+}
+
+void TimerWheel::arm(Timer* timer, std::chrono::steady_clock::time_point deadline)
+{
+	if (timer->is_armed())
+	{
+		this->_unlink(timer);
+	}
+
+	// The range of the wheel is limited, farther timers are moved down
+	// from the last level earlier than expected.
+	constexpr uint64_t range = ((uint64_t)1 << (SLOT_BITS * LEVELS)) - 1;
+	timer->expiry_tick = std::clamp(this->_to_tick(deadline), this->_current_tick + 1, this->_current_tick + range);
+	this->_insert(timer);
+}
+
+void TimerWheel::cancel(Timer* timer)
+{
+	if (timer->is_armed())
+	{
+		this->_unlink(timer);
+	}
+}
+
+void TimerWheel::advance(std::chrono::steady_clock::time_point now, std::vector<Timer*>& expired)
+{
+	uint64_t target_tick = now > this->_start ? (now - this->_start) / this->_resolution : 0;
+	while (this->_current_tick < target_tick)
+	{
+		if (this->_size == 0)
+		{
+			this->_current_tick = target_tick;
+			break;
+		}
+
+		// Ticks without timers are skipped up to the next cascade.
+		if (this->_occupied[0] == 0)
+		{
+			auto boundary = ((this->_current_tick >> SLOT_BITS) + 1) << SLOT_BITS;
+			this->_current_tick = std::min(target_tick, boundary) - 1;
+		}
+
+		auto tick = ++this->_current_tick;
+		for (size_t level = 1; level < LEVELS; level++)
+		{
+			if (tick & (((uint64_t)1 << (SLOT_BITS * level)) - 1))
+			{
+				break;
+			}
+
+			this->_cascade(level);
+		}
+
+		auto& sentinel = this->_slots[tick & (SLOTS - 1)];
+		while (sentinel.next != &sentinel)
+		{
+			auto* timer = sentinel.next;
+			this->_unlink(timer);
+			expired.push_back(timer);
+		}
+	}
+}
+
+std::chrono::steady_clock::time_point TimerWheel::next_expiry() const
+{
+	if (this->_size == 0)
+	{
+		return std::chrono::steady_clock::time_point::max();
+	}
+
+	auto tick = std::numeric_limits<uint64_t>::max();
+	if (this->_occupied[0])
+	{
+		// Timers of the first level expire within a turn after the
+		// current tick.
+		auto shift = (int)((this->_current_tick + 1) & (SLOTS - 1));
+		tick = this->_current_tick + 1 + std::countr_zero(std::rotr(this->_occupied[0], shift));
+	}
+
+	bool has_upper_timers = std::any_of(
+		this->_occupied.begin() + 1, this->_occupied.end(), [](auto bits) { return bits != 0; }
+	);
+	if (has_upper_timers)
+	{
+		tick = std::min(tick, ((this->_current_tick >> SLOT_BITS) + 1) << SLOT_BITS);
+	}
+
+	return this->_start + this->_resolution * tick;
+}
+
+uint64_t TimerWheel::_to_tick(std::chrono::steady_clock::time_point time_point) const
+{
+	if (time_point <= this->_start)
+	{
+		return 0;
+	}
+
+	// Rounded up, so timers never expire early.
+	auto duration = time_point - this->_start;
+	auto tick = duration / this->_resolution;
+	return duration % this->_resolution == std::chrono::steady_clock::duration::zero() ? tick : tick + 1;
+}
+
+void TimerWheel::_insert(Timer* timer)
+{
+	auto delta = timer->expiry_tick - this->_current_tick;
+	size_t level = 0;
+	while (level < LEVELS - 1 && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+	{
+		level++;
+	}
+
+	auto slot = (timer->expiry_tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+	timer->slot_index = level * SLOTS + slot;
+	auto& sentinel = this->_slots[timer->slot_index];
+	timer->previous = sentinel.previous;
+	timer->next = &sentinel;
+	sentinel.previous->next = timer;
+	sentinel.previous = timer;
+	this->_occupied[level] |= (uint64_t)1 << slot;
+	this->_size++;
+}
+
+void TimerWheel::_unlink(Timer* timer)
+{
+	timer->previous->next = timer->next;
+	timer->next->previous = timer->previous;
+	auto& sentinel = this->_slots[timer->slot_index];
+	if (sentinel.next == &sentinel)
+	{
+		this->_occupied[timer->slot_index / SLOTS] &= ~((uint64_t)1 << (timer->slot_index % SLOTS));
+	}
+
+	timer->previous = nullptr;
+	timer->next = nullptr;
+	this->_size--;
+}
+
+void TimerWheel::_cascade(size_t level)
+{
+	auto slot = (this->_current_tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+	auto& sentinel = this->_slots[level * SLOTS + slot];
+	if (sentinel.next == &sentinel)
+	{
+		return;
+	}
+
+	// The list is detached first, because timers of the last level
+	// may return to the same slot.
+	Timer pending;
+	pending.next = sentinel.next;
+	pending.previous = sentinel.previous;
+	pending.next->previous = &pending;
+	pending.previous->next = &pending;
+	sentinel.next = &sentinel;
+	sentinel.previous = &sentinel;
+	this->_occupied[level] &= ~((uint64_t)1 << slot);
+	while (pending.next != &pending)
+	{
+		auto* timer = pending.next;
+		pending.next = timer->next;
+		timer->next->previous = &pending;
+		this->_size--;
+		this->_insert(timer);
+	}
+}
+
+__SERVER_END__
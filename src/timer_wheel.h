@@ -0,0 +1,118 @@
+/**
+ * timer_wheel.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Hierarchical timer wheel for deadlines of connections.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Module definitions.
+#include "./_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: TimerWheel
+// Keeps timers in 'LEVELS' wheels of 'SLOTS' slots each. A slot of the
+// first wheel spans a single tick, a slot of every next wheel spans all
+// slots of the previous one. Timers of upper wheels are moved down
+// when the lower wheel completes a turn, so arming and cancelling are
+// O(1) and expiring costs O(1) per timer.
+//
+// Timers are intrusive: the wheel does not allocate and does not own
+// them. An armed timer should be cancelled before it is destroyed.
+//
+// Not thread-safe.
+class TimerWheel final
+{
+public:
+	struct Timer
+	{
+		Timer* previous = nullptr;
+		Timer* next = nullptr;
+		uint64_t expiry_tick = 0;
+		size_t slot_index = 0;
+
+		// Owner of the timer, returned by 'advance'.
+		void* data = nullptr;
+
+		[[nodiscard]]
+		inline bool is_armed() const
+		{
+			return this->next != nullptr;
+		}
+	};
+
+	static constexpr size_t LEVELS = 4;
+	static constexpr size_t SLOT_BITS = 6;
+	static constexpr size_t SLOTS = 1 << SLOT_BITS;
+
+	// With the default resolution deadlines up to 46 hours are exact,
+	// later ones expire at that range.
+	explicit TimerWheel(
+		std::chrono::milliseconds resolution = std::chrono::milliseconds(10),
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now()
+	);
+
+	TimerWheel(const TimerWheel&) = delete;
+
+	TimerWheel& operator= (const TimerWheel&) = delete;
+
+	// Re-arms 'timer' if it is armed already. Deadlines in the past
+	// expire on the next tick.
+	void arm(Timer* timer, std::chrono::steady_clock::time_point deadline);
+
+	void cancel(Timer* timer);
+
+	// Moves the wheel to 'now' and appends expired timers to 'expired'.
+	// Expired timers are disarmed.
+	void advance(std::chrono::steady_clock::time_point now, std::vector<Timer*>& expired);
+
+	// Returns the time when 'advance' should be called next, it is not
+	// later than the nearest deadline. Returns the maximum time point if
+	// there are no timers.
+	[[nodiscard]]
+	std::chrono::steady_clock::time_point next_expiry() const;
+
+	[[nodiscard]]
+	inline size_t size() const
+	{
+		return this->_size;
+	}
+
+private:
+	std::chrono::milliseconds _resolution;
+	std::chrono::steady_clock::time_point _start;
+
+	// The last processed tick.
+	uint64_t _current_tick;
+
+	size_t _size;
+
+	// Sentinels of circular lists of timers.
+	std::array<Timer, LEVELS * SLOTS> _slots;
+
+	// Bit per non-empty slot of each level.
+	std::array<uint64_t, LEVELS> _occupied;
+
+	[[nodiscard]]
+	uint64_t _to_tick(std::chrono::steady_clock::time_point time_point) const;
+
+	void _insert(Timer* timer);
+
+	void _unlink(Timer* timer);
+
+	// Moves timers of the slot of 'level' which starts at the current
+	// tick to lower levels.
+	void _cascade(size_t level);
+};
+
+__SERVER_END__
@@ -0,0 +1,362 @@
+/**
+ * uring.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./uring.h"
+
+#if defined(__linux__)
+
+// C++ libraries.
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Server libraries.
+#include "./exceptions.h"
+
+
+__SERVER_BEGIN__
+
+IOUring::IOUring(unsigned int entries, uint16_t buffers_count, size_t buffer_size) :
+	_sq_pointer(MAP_FAILED), _sq_size(0), _cq_pointer(MAP_FAILED), _cq_size(0),
+	_sqes((io_uring_sqe*)MAP_FAILED), _sqes_size(0),
+	_sq_local_tail(0), _sq_submitted_tail(0), _buffer_size(buffer_size), _buffers_count(buffers_count)
+{
+	io_uring_params params{};
+	this->_ring_descriptor = (int)::syscall(__NR_io_uring_setup, entries, &params);
+	if (this->_ring_descriptor < 0)
+	{
+		auto error_code = errno;
+		throw SocketError(
+			error_code, "'io_uring_setup' call failed: " + std::to_string(error_code), _ERROR_DETAILS_
+		);
+	}
+
+	this->_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	this->_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (single_mmap)
+	{
+		this->_sq_size = this->_cq_size = std::max(this->_sq_size, this->_cq_size);
+	}
+
+	this->_sq_pointer = ::mmap(
+		nullptr, this->_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		this->_ring_descriptor, IORING_OFF_SQ_RING
+	);
+	if (single_mmap)
+	{
+		this->_cq_pointer = this->_sq_pointer;
+	}
+	else if (this->_sq_pointer != MAP_FAILED)
+	{
+		this->_cq_pointer = ::mmap(
+			nullptr, this->_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			this->_ring_descriptor, IORING_OFF_CQ_RING
+		);
+	}
+
+	if (this->_cq_pointer != MAP_FAILED)
+	{
+		this->_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		this->_sqes = (io_uring_sqe*)::mmap(
+			nullptr, this->_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			this->_ring_descriptor, IORING_OFF_SQES
+		);
+	}
+
+	if (this->_sqes == MAP_FAILED)
+	{
+		auto error_code = errno;
+		this->_unmap();
+		::close(this->_ring_descriptor);
+		throw SocketError(error_code, "'mmap' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+	}
+
+	auto* sq = (char*)this->_sq_pointer;
+	this->_sq_head = (unsigned*)(sq + params.sq_off.head);
+	this->_sq_tail = (unsigned*)(sq + params.sq_off.tail);
+	this->_sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	this->_sq_entries = *(unsigned*)(sq + params.sq_off.ring_entries);
+	this->_sq_local_tail = this->_sq_submitted_tail = *this->_sq_tail;
+
+	// Entries are always taken in order, so the indirection array
+	// maps each slot to itself.
+	auto* sq_array = (unsigned*)(sq + params.sq_off.array);
+	for (unsigned i = 0; i < this->_sq_entries; i++)
+	{
+		sq_array[i] = i;
+	}
+
+	auto* cq = (char*)this->_cq_pointer;
+	this->_cq_head = (unsigned*)(cq + params.cq_off.head);
+	this->_cq_tail = (unsigned*)(cq + params.cq_off.tail);
+	this->_cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+	this->_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	if (this->_buffers_count > 0 && this->_buffer_size > 0)
+	{
+		try
+		{
+			this->_provide_buffers();
+		}
+		catch (const SocketError&)
+		{
+			this->_unmap();
+			::close(this->_ring_descriptor);
+			throw;
+		}
+	}
+}
+
+IOUring::~IOUring()
+{
+	this->_unmap();
+	::close(this->_ring_descriptor);
+}
+
+io_uring_sqe* IOUring::get_sqe()
+{
+	auto head = __atomic_load_n(this->_sq_head, __ATOMIC_ACQUIRE);
+	if (this->_sq_local_tail - head >= this->_sq_entries)
+	{
+		if (this->submit() < 0)
+		{
+			return nullptr;
+		}
+
+		head = __atomic_load_n(this->_sq_head, __ATOMIC_ACQUIRE);
+		if (this->_sq_local_tail - head >= this->_sq_entries)
+		{
+			return nullptr;
+		}
+	}
+
+	auto* sqe = &this->_sqes[this->_sq_local_tail & this->_sq_mask];
+	std::memset(sqe, 0, sizeof(io_uring_sqe));
+	this->_sq_local_tail++;
+	return sqe;
+}
+
+int IOUring::submit(unsigned int wait_count)
+{
+	auto to_submit = this->_sq_local_tail - this->_sq_submitted_tail;
+	__atomic_store_n(this->_sq_tail, this->_sq_local_tail, __ATOMIC_RELEASE);
+	this->_sq_submitted_tail = this->_sq_local_tail;
+	unsigned int flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0;
+	int result;
+	do
+	{
+		result = (int)::syscall(
+			__NR_io_uring_enter, this->_ring_descriptor, to_submit, wait_count, flags, nullptr, 0
+		);
+
+		// Entries are consumed even if the call is interrupted while
+		// waiting, so only completions are waited for again.
+		to_submit = 0;
+	}
+	while (result < 0 && errno == EINTR);
+	return result < 0 ? -errno : result;
+}
+
+io_uring_cqe* IOUring::peek_cqe() const
+{
+	auto head = *this->_cq_head;
+	if (head == __atomic_load_n(this->_cq_tail, __ATOMIC_ACQUIRE))
+	{
+		return nullptr;
+	}
+
+	return &this->_cqes[head & this->_cq_mask];
+}
+
+void IOUring::cqe_seen()
+{
+	__atomic_store_n(this->_cq_head, *this->_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+void IOUring::prepare_accept(Socket socket, bool multishot, uint64_t user_data)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = socket;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	if (multishot)
+	{
+		sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+	}
+
+	sqe->user_data = user_data;
+}
+
+void IOUring::prepare_recv(Socket socket, size_t length, uint64_t user_data, bool link, int flags)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = socket;
+	sqe->len = (uint32_t)std::min(length, this->_buffer_size);
+	sqe->msg_flags = flags;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	if (link)
+	{
+		sqe->flags |= IOSQE_IO_LINK;
+	}
+
+	sqe->buf_group = BUFFER_GROUP_ID;
+	sqe->user_data = user_data;
+}
+
+void IOUring::prepare_send(Socket socket, const char* data, size_t length, uint64_t user_data, bool link)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = socket;
+	sqe->addr = (uint64_t)data;
+	sqe->len = (uint32_t)length;
+	sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+	if (link)
+	{
+		sqe->flags = IOSQE_IO_LINK;
+	}
+
+	sqe->user_data = user_data;
+}
+
+void IOUring::prepare_shutdown(Socket socket, int how, uint64_t user_data, bool link)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_SHUTDOWN;
+	sqe->fd = socket;
+	sqe->len = how;
+	if (link)
+	{
+		sqe->flags = IOSQE_IO_LINK;
+	}
+
+	sqe->user_data = user_data;
+}
+
+void IOUring::prepare_link_timeout(__kernel_timespec* timeout, uint64_t user_data)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_LINK_TIMEOUT;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)timeout;
+	sqe->len = 1;
+	sqe->user_data = user_data;
+}
+
+void IOUring::prepare_timeout(__kernel_timespec* timeout, uint64_t user_data)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_TIMEOUT;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)timeout;
+	sqe->len = 1;
+	sqe->user_data = user_data;
+}
+
+void IOUring::prepare_cancel(uint64_t target_user_data, uint64_t user_data)
+{
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = target_user_data;
+	sqe->user_data = user_data;
+}
+
+char* IOUring::selected_buffer(uint32_t flags) const
+{
+	auto buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+	return this->_buffers.get() + buffer_id * this->_buffer_size;
+}
+
+void IOUring::recycle_buffer(uint32_t flags)
+{
+	auto buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+	auto* sqe = require_non_null(this->get_sqe(), "submission queue is full", _ERROR_DETAILS_);
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = 1;
+	sqe->addr = (uint64_t)this->selected_buffer(flags);
+	sqe->len = (uint32_t)this->_buffer_size;
+	sqe->off = buffer_id;
+	sqe->buf_group = BUFFER_GROUP_ID;
+	sqe->user_data = 0;
+}
+
+IOUring* IOUring::for_current_thread(unsigned int entries, xw::ILogger* logger)
+{
+	thread_local std::unique_ptr<IOUring> ring = nullptr;
+	thread_local bool is_failed = false;
+	if (!ring && !is_failed)
+	{
+		try
+		{
+			ring = std::make_unique<IOUring>(entries);
+		}
+		catch (const SocketError& exc)
+		{
+			is_failed = true;
+			ring = nullptr;
+			if (logger)
+			{
+				logger->warning(
+					"io_uring is unavailable, falling back to selectors: " + std::string(exc.what())
+				);
+			}
+		}
+	}
+
+	return ring.get();
+}
+
+void IOUring::_provide_buffers()
+{
+	this->_buffers = std::make_unique<char[]>(this->_buffers_count * this->_buffer_size);
+	auto* sqe = this->get_sqe();
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = this->_buffers_count;
+	sqe->addr = (uint64_t)this->_buffers.get();
+	sqe->len = (uint32_t)this->_buffer_size;
+	sqe->off = 0;
+	sqe->buf_group = BUFFER_GROUP_ID;
+	sqe->user_data = 0;
+	int result = this->submit(1);
+	if (result >= 0)
+	{
+		auto* cqe = this->peek_cqe();
+		result = cqe ? cqe->res : -EAGAIN;
+		this->cqe_seen();
+	}
+
+	if (result < 0)
+	{
+		throw SocketError(-result, "unable to provide buffers: " + std::to_string(-result), _ERROR_DETAILS_);
+	}
+}
+
+void IOUring::_unmap()
+{
+	if (this->_sqes != MAP_FAILED)
+	{
+		::munmap(this->_sqes, this->_sqes_size);
+	}
+
+	if (this->_cq_pointer != MAP_FAILED && this->_cq_pointer != this->_sq_pointer)
+	{
+		::munmap(this->_cq_pointer, this->_cq_size);
+	}
+
+	if (this->_sq_pointer != MAP_FAILED)
+	{
+		::munmap(this->_sq_pointer, this->_sq_size);
+	}
+}
+
+__SERVER_END__
+
+#endif // __linux__
@@ -0,0 +1,152 @@
+/**
+ * uring.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Minimal wrapper of Linux 'io_uring' interface built on raw system
+ * calls. Used by the server for batched accept, read and write
+ * submissions.
+ */
+
+#pragma once
+
+#if defined(__linux__)
+
+// C++ libraries.
+#include <memory>
+#include <vector>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+// Base libraries.
+#include <xalwart.base/interfaces/base.h>
+
+// Module definitions.
+#include "./_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: IOUring
+// Submission and completion queues of a ring shared with the kernel.
+// Operations are prepared into the submission queue and handed to the
+// kernel together by 'submit', so a single system call performs
+// several of them. Results are taken from the completion queue by
+// 'peek_cqe' and matched to operations by their user data.
+//
+// A ring is not thread-safe, streams use the ring of their thread
+// which is returned by 'for_current_thread'. The socket of a stream is
+// owned by it, so rings shut sockets down, but never close them.
+class IOUring final
+{
+public:
+	static constexpr uint16_t BUFFER_GROUP_ID = 0;
+	static constexpr uint16_t DEFAULT_BUFFERS_COUNT = 32;
+	static constexpr size_t DEFAULT_BUFFER_SIZE = 16384;
+
+	// Creates the ring and provides 'buffers_count' buffers of
+	// 'buffer_size' bytes which the kernel selects for 'prepare_recv'
+	// operations.
+	//
+	// Throws 'SocketError' if the kernel does not support 'io_uring' or
+	// it is forbidden by the environment.
+	explicit IOUring(
+		unsigned int entries, uint16_t buffers_count=DEFAULT_BUFFERS_COUNT, size_t buffer_size=DEFAULT_BUFFER_SIZE
+	);
+
+	IOUring(const IOUring&) = delete;
+
+	IOUring& operator= (const IOUring&) = delete;
+
+	~IOUring();
+
+	// Returns the next free submission queue entry. If the queue is
+	// full, already prepared entries are submitted first.
+	io_uring_sqe* get_sqe();
+
+	// Submit prepared entries and wait for at least 'wait_count'
+	// completions. Returns the count of submitted entries or negative
+	// error code.
+	int submit(unsigned int wait_count=0);
+
+	// Returns the next completion queue entry or nullptr if there are
+	// no completions yet.
+	[[nodiscard]]
+	io_uring_cqe* peek_cqe() const;
+
+	// Marks the entry returned by 'peek_cqe' as consumed.
+	void cqe_seen();
+
+	// Accepted sockets are non-blocking and closed on exec. Addresses of
+	// peers are not received, since a multishot operation has no place
+	// for them, they should be queried by 'getpeername'.
+	void prepare_accept(Socket socket, bool multishot, uint64_t user_data);
+
+	// Receives into one of the provided buffers. 'flags' are passed to
+	// 'recv', e.g. 'MSG_DONTWAIT' completes with '-EAGAIN' instead of
+	// waiting for data.
+	void prepare_recv(Socket socket, size_t length, uint64_t user_data, bool link, int flags=0);
+
+	void prepare_send(Socket socket, const char* data, size_t length, uint64_t user_data, bool link);
+
+	void prepare_shutdown(Socket socket, int how, uint64_t user_data, bool link);
+
+	// Links the timeout to the previously prepared entry, which must be
+	// created with 'link' set. 'timeout' should live until completion.
+	void prepare_link_timeout(__kernel_timespec* timeout, uint64_t user_data);
+
+	void prepare_timeout(__kernel_timespec* timeout, uint64_t user_data);
+
+	// Cancels the pending operation with 'target_user_data', which
+	// completes with '-ECANCELED' then.
+	void prepare_cancel(uint64_t target_user_data, uint64_t user_data);
+
+	// Returns the provided buffer selected by the kernel for completion
+	// with 'flags'.
+	[[nodiscard]]
+	char* selected_buffer(uint32_t flags) const;
+
+	// Returns the provided buffer back to the kernel. The buffer is
+	// handed over with the next submission, its completion has zero
+	// user data and should be ignored.
+	void recycle_buffer(uint32_t flags);
+
+	// Ring created lazily for the calling thread. Returns nullptr if the
+	// ring can not be created, in this case 'logger' receives the reason
+	// once.
+	static IOUring* for_current_thread(unsigned int entries, xw::ILogger* logger);
+
+private:
+	int _ring_descriptor;
+
+	void* _sq_pointer;
+	size_t _sq_size;
+	void* _cq_pointer;
+	size_t _cq_size;
+	io_uring_sqe* _sqes;
+	size_t _sqes_size;
+
+	unsigned* _sq_head;
+	unsigned* _sq_tail;
+	unsigned _sq_mask;
+	unsigned _sq_entries;
+	unsigned _sq_local_tail;
+	unsigned _sq_submitted_tail;
+
+	unsigned* _cq_head;
+	unsigned* _cq_tail;
+	unsigned _cq_mask;
+	io_uring_cqe* _cqes;
+
+	std::unique_ptr<char[]> _buffers;
+	size_t _buffer_size;
+	uint16_t _buffers_count;
+
+	void _provide_buffers();
+
+	void _unmap();
+};
+
+__SERVER_END__
+
+#endif // __linux__
@@ -10,6 +10,11 @@
 #include <chrono>
 #include <thread>
 #include <unistd.h>
+#if defined(__linux__)
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 // Base libraries.
 #include <xalwart.base/string_utils.h>
@@ -177,4 +182,38 @@ std::string get_fully_qualified_domain_name(const std::string& name)
 	return result_name;
 }
 
+#if defined(__linux__)
+void attach_cpu_steering_program(Socket socket, size_t group_size)
+{
+	sock_filter code[] = {
+		// A = current CPU
+		{BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)},
+
+		// A = A % group_size
+		{BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)group_size},
+
+		// return A
+		{BPF_RET | BPF_A, 0, 0, 0}
+	};
+	sock_fprog program{
+		.len = sizeof(code) / sizeof(code[0]),
+		.filter = code
+	};
+	if (::setsockopt(socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)))
+	{
+		auto error_code = errno;
+		throw SocketError(error_code, "'setsockopt' call failed: " + std::to_string(error_code), _ERROR_DETAILS_);
+	}
+}
+
+void pin_current_thread_to_cpu(size_t cpu)
+{
+	auto cpus_count = std::max(std::thread::hardware_concurrency(), 1u);
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu % cpus_count, &cpu_set);
+	::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set);
+}
+#endif
+
 __SERVER_UTIL_END__
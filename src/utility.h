@@ -66,6 +66,16 @@ extern hostent* get_host_by_address(const std::string& address);
 // An empty argument is interpreted as meaning the local host.
 extern std::string get_fully_qualified_domain_name(const std::string& name="");
 
+#if defined(__linux__)
+// Attaches classic BPF program to the 'SO_REUSEPORT' group of 'socket'
+// which selects the socket with index equal to the index of the CPU
+// that received the connection, modulo 'group_size'.
+extern void attach_cpu_steering_program(Socket socket, size_t group_size);
+
+// Restricts the calling thread to 'cpu' modulo count of CPUs.
+extern void pin_current_thread_to_cpu(size_t cpu);
+#endif
+
 // TESTME: socket_is_valid
 // TODO: docs for 'socket_is_valid'
 inline bool socket_is_valid(Socket socket)
@@ -0,0 +1,437 @@
+/**
+ * workers/work_stealing_worker.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ */
+
+#include "./work_stealing_worker.h"
+
+// C++ libraries.
+#include <algorithm>
+#include <climits>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Base libraries.
+#include <xalwart.base/exceptions.h>
+
+
+__SERVER_BEGIN__
+
+// Pool and index of the pool thread which runs the code.
+static thread_local WorkStealingWorker* current_worker = nullptr;
+static thread_local size_t current_thread_index = 0;
+
+static size_t round_up_to_power_of_two(size_t value)
+{
+	size_t result = 1;
+	while (result < value)
+	{
+		result <<= 1;
+	}
+
+	return result;
+}
+
+TaskDeque::Buffer::Buffer(size_t capacity) :
+	mask(capacity - 1), items(std::make_unique<std::atomic<AbstractWorker::Task*>[]>(capacity))
+{
+}
+
+TaskDeque::TaskDeque(size_t capacity) : _top(0), _bottom(0)
+{
+	this->_buffers.push_back(std::make_unique<Buffer>(round_up_to_power_of_two(std::max(capacity, (size_t)2))));
+	this->_buffer.store(this->_buffers.back().get(), std::memory_order_relaxed);
+}
+
+TaskDeque::~TaskDeque()
+{
+	while (auto* task = this->pop())
+	{
+		delete task;
+	}
+}
+
+void TaskDeque::push(AbstractWorker::Task* task)
+{
+	auto bottom = this->_bottom.load(std::memory_order_relaxed);
+	auto top = this->_top.load(std::memory_order_acquire);
+	auto* buffer = this->_buffer.load(std::memory_order_relaxed);
+	if (bottom - top > (int64_t)buffer->capacity() - 1)
+	{
+		buffer = this->_grow(buffer, top, bottom);
+	}
+
+	buffer->put(bottom, task);
+	std::atomic_thread_fence(std::memory_order_release);
+	this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+AbstractWorker::Task* TaskDeque::pop()
+{
+	auto bottom = this->_bottom.load(std::memory_order_relaxed) - 1;
+	auto* buffer = this->_buffer.load(std::memory_order_relaxed);
+	this->_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto top = this->_top.load(std::memory_order_relaxed);
+	if (top > bottom)
+	{
+		this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	auto* task = buffer->get(bottom);
+	if (top == bottom)
+	{
+		// The last task, thieves compete for it.
+		if (!this->_top.compare_exchange_strong(
+			top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed
+		))
+		{
+			task = nullptr;
+		}
+
+		this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return task;
+}
+
+AbstractWorker::Task* TaskDeque::steal()
+{
+	auto top = this->_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto bottom = this->_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+
+	auto* task = this->_buffer.load(std::memory_order_acquire)->get(top);
+	if (!this->_top.compare_exchange_strong(
+		top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed
+	))
+	{
+		return nullptr;
+	}
+
+	return task;
+}
+
+bool TaskDeque::empty() const
+{
+	return this->_top.load(std::memory_order_acquire) >= this->_bottom.load(std::memory_order_acquire);
+}
+
+TaskDeque::Buffer* TaskDeque::_grow(Buffer* buffer, int64_t top, int64_t bottom)
+{
+	auto new_buffer = std::make_unique<Buffer>(buffer->capacity() * 2);
+	for (auto i = top; i < bottom; i++)
+	{
+		new_buffer->put(i, buffer->get(i));
+	}
+
+	auto* result = new_buffer.get();
+	this->_buffers.push_back(std::move(new_buffer));
+	this->_buffer.store(result, std::memory_order_release);
+	return result;
+}
+
+WorkStealingWorker::WorkStealingWorker(size_t threads_count, xw::ILogger* logger) :
+	_logger(logger), _next_inbox(0), _epoch(0), _sleepers_count(0), _searching_count(0), _is_stopped(false)
+{
+	if (threads_count == 0)
+	{
+		threads_count = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	for (size_t i = 0; i < threads_count; i++)
+	{
+		this->_threads.push_back(std::make_unique<Thread>());
+		this->_threads.back()->random_state = i * 0x9E3779B97F4A7C15ull + 1;
+	}
+
+	// Threads are started when all deques exist, because they steal
+	// from each other.
+	for (size_t i = 0; i < threads_count; i++)
+	{
+		this->_threads[i]->thread = std::thread([this, i]() { this->_run(i); });
+	}
+}
+
+WorkStealingWorker::~WorkStealingWorker()
+{
+	this->stop();
+	for (const auto& thread : this->_threads)
+	{
+		for (auto* task : thread->inbox)
+		{
+			delete task;
+		}
+	}
+}
+
+void WorkStealingWorker::inject_task(std::unique_ptr<Task> task)
+{
+	if (!task || this->_is_stopped.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	if (current_worker == this)
+	{
+		this->_threads[current_thread_index]->deque.push(task.release());
+	}
+	else
+	{
+		auto index = this->_next_inbox.fetch_add(1, std::memory_order_relaxed) % this->_threads.size();
+		auto& thread = *this->_threads[index];
+		std::lock_guard lock(thread.inbox_mutex);
+		thread.inbox.push_back(task.release());
+		thread.inbox_size.store(thread.inbox.size(), std::memory_order_release);
+	}
+
+	this->_wake_if_idle();
+}
+
+void WorkStealingWorker::stop()
+{
+	std::lock_guard lock(this->_stop_mutex);
+	this->_is_stopped.store(true, std::memory_order_release);
+	this->_epoch.fetch_add(1, std::memory_order_seq_cst);
+	this->_wake(INT_MAX);
+	for (const auto& thread : this->_threads)
+	{
+		if (thread->thread.joinable() && thread->thread.get_id() != std::this_thread::get_id())
+		{
+			thread->thread.join();
+		}
+	}
+}
+
+void WorkStealingWorker::_run(size_t index)
+{
+	current_worker = this;
+	current_thread_index = index;
+	auto& deque = this->_threads[index]->deque;
+	while (true)
+	{
+		auto* task = deque.pop();
+		if (task)
+		{
+			this->_execute(task);
+			continue;
+		}
+
+		this->_searching_count.fetch_add(1, std::memory_order_seq_cst);
+		for (size_t i = 0; i < SPIN_COUNT && !task; i++)
+		{
+			task = this->_find_task(index);
+		}
+
+		// The last searcher which found a task wakes the next one, so
+		// the rest of queued tasks is picked up in parallel.
+		auto searching_count = this->_searching_count.fetch_sub(1, std::memory_order_seq_cst);
+		if (task)
+		{
+			if (searching_count == 1)
+			{
+				this->_wake_if_idle();
+			}
+
+			this->_execute(task);
+			continue;
+		}
+
+		// Tasks injected after the epoch is read change it, so the
+		// thread does not sleep through them.
+		auto epoch = this->_epoch.load(std::memory_order_seq_cst);
+		task = this->_find_task(index);
+		if (task)
+		{
+			this->_execute(task);
+			continue;
+		}
+
+		if (this->_is_stopped.load(std::memory_order_acquire))
+		{
+			break;
+		}
+
+		this->_park(epoch);
+	}
+}
+
+AbstractWorker::Task* WorkStealingWorker::_find_task(size_t index)
+{
+	auto& thread = *this->_threads[index];
+	if (auto* task = thread.deque.pop())
+	{
+		return task;
+	}
+
+	if (auto* task = this->_take_inbox(thread, true))
+	{
+		return task;
+	}
+
+	return this->_steal(index);
+}
+
+AbstractWorker::Task* WorkStealingWorker::_take_inbox(Thread& thread, bool take_all)
+{
+	if (thread.inbox_size.load(std::memory_order_acquire) == 0)
+	{
+		return nullptr;
+	}
+
+	std::vector<Task*> tasks;
+	{
+		std::unique_lock lock(thread.inbox_mutex, std::defer_lock);
+		if (take_all)
+		{
+			lock.lock();
+		}
+		else if (!lock.try_lock())
+		{
+			return nullptr;
+		}
+
+		if (thread.inbox.empty())
+		{
+			return nullptr;
+		}
+
+		if (!take_all)
+		{
+			// A thief takes the oldest task only, the rest stays with
+			// the owner.
+			auto* task = thread.inbox.front();
+			thread.inbox.erase(thread.inbox.begin());
+			thread.inbox_size.store(thread.inbox.size(), std::memory_order_release);
+			return task;
+		}
+
+		tasks.swap(thread.inbox);
+		thread.inbox_size.store(0, std::memory_order_release);
+	}
+
+	// The owner pops from the bottom, so tasks are pushed in reverse
+	// order to be processed in the order of injection.
+	for (size_t i = tasks.size() - 1; i > 0; i--)
+	{
+		thread.deque.push(tasks[i]);
+	}
+
+	if (tasks.size() > 1)
+	{
+		this->_wake_if_idle();
+	}
+
+	return tasks.front();
+}
+
+AbstractWorker::Task* WorkStealingWorker::_steal(size_t index)
+{
+	auto threads_count = this->_threads.size();
+	if (threads_count < 2)
+	{
+		return nullptr;
+	}
+
+	// xorshift64
+	auto& state = this->_threads[index]->random_state;
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	auto start = state % threads_count;
+	for (size_t i = 0; i < threads_count; i++)
+	{
+		auto victim_index = (start + i) % threads_count;
+		if (victim_index == index)
+		{
+			continue;
+		}
+
+		auto& victim = *this->_threads[victim_index];
+		if (auto* task = victim.deque.steal())
+		{
+			return task;
+		}
+
+		// Injected tasks of a busy thread would wait for it otherwise.
+		if (auto* task = this->_take_inbox(victim, false))
+		{
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
+void WorkStealingWorker::_execute(Task* task)
+{
+	std::unique_ptr<Task> owned_task(task);
+	try
+	{
+		this->notify(owned_task.get());
+	}
+	catch (const BaseException& exc)
+	{
+		if (this->_logger)
+		{
+			this->_logger->error(exc);
+		}
+	}
+	catch (const std::exception& exc)
+	{
+		if (this->_logger)
+		{
+			this->_logger->error(exc.what(), _ERROR_DETAILS_);
+		}
+	}
+}
+
+void WorkStealingWorker::_park(uint32_t epoch)
+{
+	this->_sleepers_count.fetch_add(1, std::memory_order_seq_cst);
+#if defined(__linux__)
+	::syscall(SYS_futex, (uint32_t*)&this->_epoch, FUTEX_WAIT_PRIVATE, epoch, nullptr, nullptr, 0);
+#else
+	this->_epoch.wait(epoch, std::memory_order_seq_cst);
+#endif
+	this->_sleepers_count.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void WorkStealingWorker::_wake_if_idle()
+{
+	this->_epoch.fetch_add(1, std::memory_order_seq_cst);
+	if (
+		this->_searching_count.load(std::memory_order_seq_cst) == 0 &&
+		this->_sleepers_count.load(std::memory_order_seq_cst) > 0
+	)
+	{
+		this->_wake(1);
+	}
+}
+
+void WorkStealingWorker::_wake(int count)
+{
+#if defined(__linux__)
+	::syscall(SYS_futex, (uint32_t*)&this->_epoch, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+	if (count == 1)
+	{
+		this->_epoch.notify_one();
+	}
+	else
+	{
+		this->_epoch.notify_all();
+	}
+#endif
+}
+
+__SERVER_END__
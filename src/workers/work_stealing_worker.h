@@ -0,0 +1,183 @@
+/**
+ * workers/work_stealing_worker.h
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Worker pool with per-thread task deques and work stealing.
+ */
+
+#pragma once
+
+// C++ libraries.
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Base libraries.
+#include <xalwart.base/interfaces/base.h>
+#include <xalwart.base/workers/abstract_worker.h>
+
+// Module definitions.
+#include "../_def_.h"
+
+
+__SERVER_BEGIN__
+
+// TESTME: TaskDeque
+// Chase-Lev work-stealing deque. The owner thread pushes and pops tasks
+// at the bottom, other threads steal them from the top without locks.
+// Replaced buffers are kept until destruction, because thieves may
+// still read them after the deque grows.
+class TaskDeque final
+{
+public:
+	static constexpr size_t DEFAULT_CAPACITY = 256;
+
+	// 'capacity' is rounded up to the power of two.
+	explicit TaskDeque(size_t capacity=DEFAULT_CAPACITY);
+
+	TaskDeque(const TaskDeque&) = delete;
+
+	TaskDeque& operator= (const TaskDeque&) = delete;
+
+	// Remaining tasks are destroyed.
+	~TaskDeque();
+
+	// Owner thread only.
+	void push(AbstractWorker::Task* task);
+
+	// Owner thread only. Returns the most recently pushed task or nullptr
+	// if the deque is empty.
+	AbstractWorker::Task* pop();
+
+	// Any thread. Returns the oldest task or nullptr if the deque is
+	// empty or another thread took the task first.
+	AbstractWorker::Task* steal();
+
+	[[nodiscard]]
+	bool empty() const;
+
+private:
+	struct Buffer
+	{
+		size_t mask;
+		std::unique_ptr<std::atomic<AbstractWorker::Task*>[]> items;
+
+		explicit Buffer(size_t capacity);
+
+		[[nodiscard]]
+		inline size_t capacity() const
+		{
+			return this->mask + 1;
+		}
+
+		[[nodiscard]]
+		inline AbstractWorker::Task* get(int64_t index) const
+		{
+			return this->items[index & this->mask].load(std::memory_order_acquire);
+		}
+
+		inline void put(int64_t index, AbstractWorker::Task* task)
+		{
+			// Publishes the task to the thread which takes it.
+			this->items[index & this->mask].store(task, std::memory_order_release);
+		}
+	};
+
+	// Thieves update 'top' and the owner updates 'bottom', so they are
+	// kept on separate cache lines.
+	alignas(64) std::atomic<int64_t> _top;
+	alignas(64) std::atomic<int64_t> _bottom;
+	std::atomic<Buffer*> _buffer;
+
+	// Owner thread only.
+	std::vector<std::unique_ptr<Buffer>> _buffers;
+
+	Buffer* _grow(Buffer* buffer, int64_t top, int64_t bottom);
+};
+
+// TESTME: WorkStealingWorker
+// 'AbstractWorker' with a thread pool where each thread owns a
+// 'TaskDeque'. Tasks injected by pool threads go to their own deques,
+// tasks injected by other threads are spread between per-thread inboxes
+// round-robin. Idle threads steal from random victims, so a slow task
+// does not block tasks queued behind it, and park on a futex when there
+// is no work.
+//
+// Listeners are registered with 'add_task_listener' as for any other
+// worker.
+class WorkStealingWorker : public AbstractWorker
+{
+public:
+	// How many times an idle thread looks for tasks before parking.
+	static constexpr size_t SPIN_COUNT = 16;
+
+	// Zero 'threads_count' means one thread per CPU core. Errors thrown
+	// by listeners are reported to 'logger' if it is not nullptr.
+	explicit WorkStealingWorker(size_t threads_count, xw::ILogger* logger=nullptr);
+
+	~WorkStealingWorker() override;
+
+	using AbstractWorker::inject_task;
+
+	// Tasks injected after 'stop' are dropped.
+	void inject_task(std::unique_ptr<Task> task) override;
+
+	// Waits until threads finish queued tasks.
+	void stop() override;
+
+	[[nodiscard]]
+	inline size_t threads_count() const
+	{
+		return this->_threads.size();
+	}
+
+private:
+	struct Thread
+	{
+		TaskDeque deque;
+
+		// Tasks injected from outside of the pool.
+		std::mutex inbox_mutex;
+		std::vector<Task*> inbox;
+		std::atomic<size_t> inbox_size = 0;
+
+		uint64_t random_state = 0;
+		std::thread thread;
+	};
+
+	xw::ILogger* _logger;
+	std::vector<std::unique_ptr<Thread>> _threads;
+	std::atomic<size_t> _next_inbox;
+
+	// Incremented on each injection, idle threads wait for its change.
+	alignas(64) std::atomic<uint32_t> _epoch;
+	std::atomic<size_t> _sleepers_count;
+
+	// Threads which look for tasks, injections do not wake parked
+	// threads while there is one.
+	std::atomic<size_t> _searching_count;
+	std::atomic<bool> _is_stopped;
+	std::mutex _stop_mutex;
+
+	void _run(size_t index);
+
+	Task* _find_task(size_t index);
+
+	Task* _take_inbox(Thread& thread, bool take_all);
+
+	Task* _steal(size_t index);
+
+	void _execute(Task* task);
+
+	void _park(uint32_t epoch);
+
+	void _wake(int count);
+
+	void _wake_if_idle();
+};
+
+__SERVER_END__
@@ -0,0 +1,232 @@
+/**
+ * request_smuggling_test.cpp
+ *
+ * Copyright (c) 2021 Yuriy Lisovskiy
+ *
+ * Checks that a body which is not read by the handler is not parsed as
+ * the next request of the connection, that chunked bodies are decoded
+ * for synchronous and coroutine handlers, and that requests whose body
+ * can not be framed by Transfer-Encoding are rejected.
+ */
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <mutex>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <xalwart.base/workers/threaded_worker.h>
+#include <xalwart.server/http_server.h>
+
+
+inline static const uint16_t BASE_PORT = 18800;
+
+inline static const std::string SMUGGLED_REQUEST = "GET /admin HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+struct Result
+{
+	std::vector<std::string> paths;
+	std::vector<std::string> bodies;
+	std::string response;
+};
+
+inline static const std::string RESPONSE = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+
+// Sends 'data' to a server with the backend of 'mode' and collects the
+// paths of handled requests until the connection is closed or idle.
+// Requests are handled by a coroutine if 'use_coroutine' is set.
+Result exchange(xw::log::Logger& logger, int mode, const std::string& data, bool read_body, bool use_coroutine=false)
+{
+	Result result;
+	std::mutex mutex;
+	auto add_result = [&](const std::string& path, const std::string& body)
+	{
+		std::lock_guard lock(mutex);
+		result.paths.push_back(path);
+		result.bodies.push_back(body);
+	};
+	xw::server::Context context{
+		.logger = &logger,
+		.timeout_seconds = 1,
+		.worker = std::make_unique<xw::ThreadedWorker>(2),
+		.handler = [&](auto* request, const auto&) -> xw::net::StatusCode
+		{
+			// Reads more than the body to check that it is limited.
+			std::string body, part;
+			while (read_body && request->body->read(part, 65536) > 0)
+			{
+				body += part;
+			}
+
+			add_result(request->path, body);
+			request->response_writer->write(RESPONSE.data(), RESPONSE.size());
+			return 200;
+		}
+	};
+#if defined(__SERVER_HAS_COROUTINES__)
+	if (use_coroutine)
+	{
+		context.handler = nullptr;
+		context.coroutine_handler = [&](
+			xw::net::RequestContext* request, const std::map<std::string, std::string>&,
+			xw::server::AsyncStream* stream
+		) -> xw::server::Coroutine<xw::net::StatusCode>
+		{
+			std::string body, part;
+			while (read_body && co_await stream->read(part, 65536) > 0)
+			{
+				body += part;
+			}
+
+			add_result(request->path, body);
+			co_await stream->write(RESPONSE);
+			co_return 200;
+		};
+	}
+#endif
+
+	context.use_reactor = mode == 1;
+	context.io_backend = mode == 2 ? xw::server::IOBackend::IOUring : xw::server::IOBackend::Selector;
+
+	auto port = (uint16_t)(BASE_PORT + mode);
+	auto server = xw::server::DevelopmentHTTPServer(std::move(context));
+	server.bind("127.0.0.1", port);
+	std::thread server_thread([&server] { server.listen(""); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	auto client = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	timeval timeout{.tv_sec = 2, .tv_usec = 0};
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	if (connect(client, (sockaddr*)&address, sizeof(address)) == 0)
+	{
+		send(client, data.data(), data.size(), MSG_NOSIGNAL);
+		char buffer[4096];
+		ssize_t count;
+		while ((count = recv(client, buffer, sizeof(buffer), 0)) > 0)
+		{
+			result.response.append(buffer, count);
+		}
+	}
+
+	close(client);
+	server.close();
+	server_thread.join();
+	return result;
+}
+
+int main()
+{
+	auto logger_config = xw::log::Config{};
+	logger_config.disable_all_levels();
+	auto logger = xw::log::Logger(logger_config);
+
+	auto head = "POST /public HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+		std::to_string(SMUGGLED_REQUEST.size()) + "\r\n\r\n";
+	auto next_request = std::string("GET /next HTTP/1.1\r\nHost: localhost\r\n\r\n");
+	auto incomplete_head = "POST /public HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+		std::to_string(SMUGGLED_REQUEST.size() + 16) + "\r\n\r\n";
+
+	// Transfer-Encoding which does not end with chunked can not frame the
+	// body, so Content-Length must not be used instead of it.
+	auto transfer_encoding_head = [](const std::string& codings)
+	{
+		return "POST /public HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: " + codings +
+			"\r\nContent-Length: " + std::to_string(SMUGGLED_REQUEST.size()) + "\r\n\r\n";
+	};
+	auto chunked_gzip_head = std::string(
+		"POST /public HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked, gzip\r\n\r\n"
+	);
+	auto gzip_chunked_head = std::string(
+		"POST /public HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+	);
+
+	// The body is a request split into two chunks, so its framing would
+	// be a part of it if it were not decoded.
+	char second_chunk_size[16];
+	std::snprintf(second_chunk_size, sizeof(second_chunk_size), "%zx", SMUGGLED_REQUEST.size() - 10);
+	auto chunked_request = "POST /public HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n"
+		"a\r\n" + SMUGGLED_REQUEST.substr(0, 10) + "\r\n" + second_chunk_size + "\r\n" +
+		SMUGGLED_REQUEST.substr(10) + "\r\n0\r\n\r\n";
+
+	const char* modes[] = {"selector", "reactor", "io_uring"};
+	int failures_count = 0;
+	auto check = [&failures_count](bool condition, const std::string& name)
+	{
+		if (!condition)
+		{
+			failures_count++;
+			std::printf("FAILED: %s\n", name.c_str());
+		}
+	};
+	for (int mode = 0; mode < 3; mode++)
+	{
+		std::string name = modes[mode];
+
+		// The unread body is skipped and the next request is handled.
+		auto result = exchange(logger, mode, head + SMUGGLED_REQUEST + next_request, false);
+		check(result.paths == std::vector<std::string>{"/public", "/next"}, name + ": unread body");
+
+		// Reads stop at the end of the body.
+		result = exchange(logger, mode, head + SMUGGLED_REQUEST + next_request, true);
+		check(result.paths == std::vector<std::string>{"/public", "/next"}, name + ": read past body");
+		check(!result.bodies.empty() && result.bodies[0] == SMUGGLED_REQUEST, name + ": body is limited");
+
+		// The rest of the body is not received, so the connection is closed.
+		result = exchange(logger, mode, incomplete_head + SMUGGLED_REQUEST, false);
+		check(result.paths == std::vector<std::string>{"/public"}, name + ": incomplete body");
+
+		// Handlers receive the data of chunks only.
+		result = exchange(logger, mode, chunked_request + next_request, true);
+		check(result.paths == std::vector<std::string>{"/public", "/next"}, name + ": chunked body");
+		check(!result.bodies.empty() && result.bodies[0] == SMUGGLED_REQUEST, name + ": chunked body is decoded");
+
+#if defined(__SERVER_HAS_COROUTINES__)
+		// Coroutines read the body by the stream, which decodes it as well.
+		result = exchange(logger, mode, chunked_request + next_request, true, true);
+		check(result.paths == std::vector<std::string>{"/public", "/next"}, name + ": coroutine chunked body");
+		check(
+			!result.bodies.empty() && result.bodies[0] == SMUGGLED_REQUEST,
+			name + ": coroutine chunked body is decoded"
+		);
+
+		result = exchange(logger, mode, head + SMUGGLED_REQUEST + next_request, true, true);
+		check(result.paths == std::vector<std::string>{"/public", "/next"}, name + ": coroutine read past body");
+		check(
+			!result.bodies.empty() && result.bodies[0] == SMUGGLED_REQUEST,
+			name + ": coroutine body is limited"
+		);
+#endif
+
+		// Requests with Transfer-Encoding which is not final chunked are
+		// rejected and the connection is closed.
+		for (const auto& codings : {"gzip", "xchunked", "chunked, chunked"})
+		{
+			result = exchange(logger, mode, transfer_encoding_head(codings) + SMUGGLED_REQUEST, false);
+			check(
+				result.paths.empty() && result.response.starts_with("HTTP/1.1 400"),
+				name + ": Transfer-Encoding '" + codings + "' with Content-Length"
+			);
+		}
+
+		result = exchange(logger, mode, chunked_gzip_head + "0\r\n\r\n" + SMUGGLED_REQUEST, false);
+		check(
+			result.paths.empty() && result.response.starts_with("HTTP/1.1 400"),
+			name + ": chunked is not the final coding"
+		);
+
+		result = exchange(logger, mode, gzip_chunked_head + "0\r\n\r\n" + SMUGGLED_REQUEST, false);
+		check(
+			result.paths.empty() && result.response.starts_with("HTTP/1.1 501"),
+			name + ": unsupported coding"
+		);
+	}
+
+	return failures_count == 0 ? 0 : 1;
+}